@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <luajit-2.0/lua.hpp>
+
+// minimal timing harness for the binding microbenchmarks
+
+struct State
+{
+    lua_State* L;
+
+    operator lua_State*() { return L; }
+    State() : L(luaL_newstate()) { luaL_openlibs(L); }
+    State(const State&) = delete;
+    ~State() { lua_close(L); }
+    State& operator=(const State&) = delete;
+};
+
+struct Result
+{
+    std::string name;
+    long iterations;
+    double ns_per_op;
+    double raw_ns_per_op;
+};
+
+class Bench
+{
+public:
+    Bench(long iterations) : iterations(iterations) { }
+
+    // times a shim operation against the equivalent raw Lua C API code
+    template<typename Shim, typename Raw>
+    void run(const char* name, Shim shim, Raw raw)
+    {
+        results.push_back({ name, iterations, time(shim, iterations),
+            time(raw, iterations) });
+    }
+
+    // for bulk cases costing about as much as weight simple ones; runs
+    // 1/weight of the iterations so every case takes similar time
+    template<typename Shim, typename Raw>
+    void run(const char* name, long weight, Shim shim, Raw raw)
+    {
+        auto n = std::max(iterations / weight, 1L);
+        results.push_back({ name, n, time(shim, n), time(raw, n) });
+    }
+
+    // one JSON object per case, so runs can be diffed between versions
+    void report(FILE* out) const
+    {
+        std::fprintf(out, "[\n");
+        for ( size_t i = 0; i < results.size(); ++i )
+        {
+            const auto& r = results[i];
+            std::fprintf(out,
+                "  { \"name\": \"%s\", \"iterations\": %ld, "
+                "\"ns_per_op\": %.3f, \"raw_ns_per_op\": %.3f, "
+                "\"ratio\": %.3f }%s\n",
+                r.name.c_str(), r.iterations, r.ns_per_op, r.raw_ns_per_op,
+                r.raw_ns_per_op > 0 ? r.ns_per_op / r.raw_ns_per_op : 0.0,
+                i + 1 < results.size() ? "," : "");
+        }
+        std::fprintf(out, "]\n");
+    }
+
+private:
+    template<typename F>
+    double time(F& f, long iterations)
+    {
+        using clock = std::chrono::steady_clock;
+
+        // warm up caches and the Lua stack
+        for ( long i = 0; i < iterations / 10; ++i )
+            f();
+
+        auto start = clock::now();
+        for ( long i = 0; i < iterations; ++i )
+            f();
+
+        std::chrono::duration<double, std::nano> elapsed = clock::now() - start;
+        return elapsed.count() / iterations;
+    }
+
+    long iterations;
+    std::vector<Result> results;
+};
+
+// keeps values observable so the optimizer can't drop the work
+template<typename T>
+inline void consume(const T& v)
+{ asm volatile("" : : "g"(&v) : "memory"); }
@@ -0,0 +1,608 @@
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "type_registration.h"
+#include "value_registration.h"
+
+#include "harness.h"
+
+// binding overhead microbenchmarks; writes JSON results to stdout
+//
+// usage: bench [iterations]
+
+namespace
+{
+// -----------------------------------------------------------------------------
+// fixtures
+// -----------------------------------------------------------------------------
+
+enum Color : char { Red = 1 };
+
+struct Point
+{
+    int x = 0;
+    int y = 0;
+
+    Point() { }
+    Point(int x, int y) : x(x), y(y) { }
+
+    int sum(int a, int b) const noexcept
+    { return x + y + a + b; }
+};
+
+// Point with its coordinates bound as properties
+struct Body : Point
+{
+    Body(int x, int y) : Point(x, y) { }
+};
+
+static int add(int a, int b) noexcept
+{ return a + b; }
+
+static int raw_add(lua_State* L)
+{
+    if ( lua_type(L, 1) != LUA_TNUMBER || lua_type(L, 2) != LUA_TNUMBER )
+        return luaL_error(L, "expected numbers");
+
+    lua_pushinteger(L, lua_tointeger(L, 1) + lua_tointeger(L, 2));
+    return 1;
+}
+
+static int raw_sum(lua_State* L)
+{
+    auto p = static_cast<Point**>(luaL_checkudata(L, 1, "Point"));
+    if ( lua_type(L, 2) != LUA_TNUMBER || lua_type(L, 3) != LUA_TNUMBER )
+        return luaL_error(L, "expected numbers");
+
+    lua_pushinteger(L, (*p)->sum(lua_tointeger(L, 2), lua_tointeger(L, 3)));
+    return 1;
+}
+
+static int raw_get_x(lua_State* L)
+{
+    auto p = static_cast<Body**>(luaL_checkudata(L, 1, "Body"));
+    lua_pushinteger(L, (*p)->x);
+    return 1;
+}
+
+static int raw_new(lua_State* L)
+{
+    if ( lua_type(L, 1) != LUA_TNUMBER || lua_type(L, 2) != LUA_TNUMBER )
+        return luaL_error(L, "expected numbers");
+
+    auto h = static_cast<Point**>(
+        lua_newuserdata(L, sizeof(Point*) + sizeof(Point)));
+
+    *h = new (h + 1) Point(lua_tointeger(L, 1), lua_tointeger(L, 2));
+
+    luaL_getmetatable(L, "Point");
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+// cases
+// -----------------------------------------------------------------------------
+
+template<typename T, typename RawPush>
+void bench_push(Bench& bench, lua_State* L, const char* name, T v,
+    RawPush raw_push, long weight = 1)
+{
+    auto top = lua_gettop(L);
+
+    bench.run(name, weight,
+        [&] { Lua::stack::push(L, v); lua_settop(L, top); },
+        [&] { raw_push(L, v); lua_settop(L, top); });
+}
+
+template<typename T, typename RawGet>
+void bench_getx(Bench& bench, lua_State* L, const char* name, int n,
+    RawGet raw_get, long weight = 1)
+{
+    bench.run(name, weight,
+        [&] { consume(Lua::stack::getx<T>(L, n)); },
+        [&] { consume(raw_get(L, n)); });
+}
+
+void bench_stack(Bench& bench, lua_State* L)
+{
+    using namespace Lua;
+
+    bench_push(bench, L, "push/integral", 42,
+        [](lua_State* L, int v) { lua_pushinteger(L, v); });
+
+    bench_push(bench, L, "push/unsigned", 42u,
+        [](lua_State* L, unsigned v) { lua_pushinteger(L, v); });
+
+    bench_push(bench, L, "push/floating_point", 4.2,
+        [](lua_State* L, double v) { lua_pushnumber(L, v); });
+
+    bench_push(bench, L, "push/boolean", true,
+        [](lua_State* L, bool v) { lua_pushboolean(L, v); });
+
+    bench_push(bench, L, "push/std_string", std::string("field_name"),
+        [](lua_State* L, const std::string& v)
+        { lua_pushlstring(L, v.c_str(), v.size()); });
+
+    static const Key field("field_name");
+    auto& strings = StringCache::open(L);
+    auto top = lua_gettop(L);
+
+    bench.run("push/key",
+        [&] { strings.push(L, field); lua_settop(L, top); },
+        [&] { lua_pushlstring(L, "field_name", 10); lua_settop(L, top); });
+
+    bench_push(bench, L, "push/c_string", "field_name",
+        [](lua_State* L, const char* v) { lua_pushstring(L, v); });
+
+    bench_push(bench, L, "push/enumeration", Color::Red,
+        [](lua_State* L, Color v) { lua_pushinteger(L, v); });
+
+    std::vector<double> doubles(16, 4.2);
+
+    bench_push(bench, L, "push/vector", doubles,
+        [](lua_State* L, const std::vector<double>& v)
+        {
+            lua_newtable(L);
+            for ( size_t i = 0; i < v.size(); ++i )
+            {
+                lua_pushnumber(L, v[i]);
+                lua_rawseti(L, -2, i + 1);
+            }
+        });
+
+    using Features = std::unordered_map<std::string, double>;
+
+    Features features;
+    for ( int i = 0; i < 1000; ++i )
+        features["feature_" + std::to_string(i)] = i;
+
+    bench_push(bench, L, "push/unordered_map", features,
+        [](lua_State* L, const Features& m)
+        {
+            lua_newtable(L);
+            for ( const auto& kv : m )
+            {
+                lua_pushlstring(L, kv.first.c_str(), kv.first.size());
+                lua_pushnumber(L, kv.second);
+                lua_rawset(L, -3);
+            }
+        }, 1000);
+
+    Pop pop(L);
+
+    lua_pushinteger(L, 42);
+    auto i = lua_gettop(L);
+
+    lua_pushnumber(L, 4.2);
+    auto d = lua_gettop(L);
+
+    lua_pushboolean(L, true);
+    auto b = lua_gettop(L);
+
+    lua_pushliteral(L, "field_name");
+    auto s = lua_gettop(L);
+
+    bench_getx<int>(bench, L, "getx/integral", i,
+        [](lua_State* L, int n)
+        {
+            if ( lua_type(L, n) != LUA_TNUMBER )
+                luaL_error(L, "expected integer");
+
+            return static_cast<int>(lua_tointeger(L, n));
+        });
+
+    bench_getx<unsigned>(bench, L, "getx/unsigned", i,
+        [](lua_State* L, int n)
+        {
+            if ( lua_type(L, n) != LUA_TNUMBER || lua_tointeger(L, n) <= 0 )
+                luaL_error(L, "expected unsigned");
+
+            return static_cast<unsigned>(lua_tointeger(L, n));
+        });
+
+    bench_getx<double>(bench, L, "getx/floating_point", d,
+        [](lua_State* L, int n)
+        {
+            if ( lua_type(L, n) != LUA_TNUMBER )
+                luaL_error(L, "expected number");
+
+            return lua_tonumber(L, n);
+        });
+
+    bench_getx<bool>(bench, L, "getx/boolean", b,
+        [](lua_State* L, int n)
+        {
+            if ( lua_type(L, n) != LUA_TBOOLEAN )
+                luaL_error(L, "expected boolean");
+
+            return lua_toboolean(L, n) != 0;
+        });
+
+    bench_getx<std::string>(bench, L, "getx/std_string", s,
+        [](lua_State* L, int n)
+        {
+            if ( lua_type(L, n) != LUA_TSTRING )
+                luaL_error(L, "expected string");
+
+            size_t len;
+            auto str = lua_tolstring(L, n, &len);
+            return std::string(str, len);
+        });
+
+    bench_getx<const char*>(bench, L, "getx/c_string", s,
+        [](lua_State* L, int n)
+        {
+            if ( lua_type(L, n) != LUA_TSTRING )
+                luaL_error(L, "expected string");
+
+            return lua_tostring(L, n);
+        });
+
+    bench_getx<StringSpan>(bench, L, "getx/string_span", s,
+        [](lua_State* L, int n)
+        {
+            if ( lua_type(L, n) != LUA_TSTRING )
+                luaL_error(L, "expected string");
+
+            size_t len;
+            auto str = lua_tolstring(L, n, &len);
+            return StringSpan(str, len);
+        });
+
+    bench_getx<Color>(bench, L, "getx/enumeration", i,
+        [](lua_State* L, int n)
+        {
+            if ( lua_type(L, n) != LUA_TNUMBER )
+                luaL_error(L, "expected enumeration");
+
+            return static_cast<Color>(lua_tointeger(L, n));
+        });
+
+    stack::push(L, doubles);
+    auto t = lua_gettop(L);
+
+    bench_getx<std::vector<double>>(bench, L, "getx/vector", t,
+        [](lua_State* L, int n)
+        {
+            if ( lua_type(L, n) != LUA_TTABLE )
+                luaL_error(L, "expected table");
+
+            std::vector<double> v;
+            for ( int i = 1; ; ++i )
+            {
+                lua_rawgeti(L, n, i);
+                if ( lua_isnil(L, -1) )
+                    break;
+
+                if ( lua_type(L, -1) != LUA_TNUMBER )
+                    luaL_error(L, "expected number");
+
+                v.push_back(lua_tonumber(L, -1));
+                lua_pop(L, 1);
+            }
+
+            lua_pop(L, 1);
+            return v;
+        });
+
+    stack::push(L, features);
+    auto m = lua_gettop(L);
+
+    bench_getx<Features>(bench, L, "getx/unordered_map", m,
+        [](lua_State* L, int n)
+        {
+            if ( lua_type(L, n) != LUA_TTABLE )
+                luaL_error(L, "expected table");
+
+            Features v;
+            lua_pushnil(L);
+            while ( lua_next(L, n) )
+            {
+                if ( lua_type(L, -2) != LUA_TSTRING ||
+                    lua_type(L, -1) != LUA_TNUMBER )
+                    luaL_error(L, "expected string to number");
+
+                size_t len;
+                auto k = lua_tolstring(L, -2, &len);
+                v.emplace(std::string(k, len), lua_tonumber(L, -1));
+                lua_pop(L, 1);
+            }
+
+            return v;
+        }, 1000);
+
+    util::userdata<Point>::emplace(L, 1, 2);
+    util::userdata<Point>::assign_metatable(L, -1);
+    auto u = lua_gettop(L);
+
+    bench_getx<Point&>(bench, L, "getx/user", u,
+        [](lua_State* L, int n) -> Point&
+        { return **static_cast<Point**>(luaL_checkudata(L, n, "Point")); });
+
+    bench.run("is/user",
+        [&] { consume(stack::is<Point>(L, u)); },
+        [&]
+        {
+            bool r = false;
+            if ( lua_getmetatable(L, u) )
+            {
+                luaL_getmetatable(L, "Point");
+                r = lua_rawequal(L, -2, -1);
+                lua_pop(L, 2);
+            }
+            consume(r);
+        });
+}
+
+// calls a function at index fn with two integer arguments
+inline void call2(lua_State* L, int fn, int top)
+{
+    lua_pushvalue(L, fn);
+    lua_pushinteger(L, 1);
+    lua_pushinteger(L, 2);
+    lua_call(L, 2, 1);
+    consume(lua_tointeger(L, -1));
+    lua_settop(L, top);
+}
+
+// calls a method at index fn on the object at index self
+inline void call_method(lua_State* L, int fn, int self, int top)
+{
+    lua_pushvalue(L, fn);
+    lua_pushvalue(L, self);
+    lua_pushinteger(L, 1);
+    lua_pushinteger(L, 2);
+    lua_call(L, 3, 1);
+    consume(lua_tointeger(L, -1));
+    lua_settop(L, top);
+}
+
+void bench_calls(Bench& bench, lua_State* L)
+{
+    using namespace Lua;
+
+    Pop pop(L);
+
+    lua_pushcfunction(L, raw_add);
+    auto raw = lua_gettop(L);
+
+    detail::auto_pusher<decltype(&add)>::push(L, &add);
+    auto bound = lua_gettop(L);
+
+    detail::function_pusher<decltype(&add), &add>::push(L);
+    auto fixed = lua_gettop(L);
+
+    detail::function_pusher<decltype(&add), &add>::
+        push<policy::unchecked>(L);
+    auto unchecked = lua_gettop(L);
+
+    auto top = lua_gettop(L);
+
+    bench.run("call/method_pusher",
+        [&] { call2(L, bound, top); },
+        [&] { call2(L, raw, top); });
+
+    bench.run("call/function_pusher",
+        [&] { call2(L, fixed, top); },
+        [&] { call2(L, raw, top); });
+
+    bench.run("call/function_pusher/unchecked",
+        [&] { call2(L, unchecked, top); },
+        [&] { call2(L, raw, top); });
+
+    lua_pushcfunction(L, raw_sum);
+    auto raw_member = lua_gettop(L);
+
+    detail::auto_pusher<decltype(&Point::sum)>::push(L, &Point::sum);
+    auto bound_member = lua_gettop(L);
+
+    detail::function_pusher<decltype(&Point::sum), &Point::sum>::push(L);
+    auto fixed_member = lua_gettop(L);
+
+    detail::function_pusher<decltype(&Point::sum), &Point::sum>::
+        push<policy::unchecked>(L);
+    auto unchecked_member = lua_gettop(L);
+
+    util::userdata<Point>::emplace(L, 1, 2);
+    util::userdata<Point>::assign_metatable(L, -1);
+    auto self = lua_gettop(L);
+
+    top = lua_gettop(L);
+
+    bench.run("call/method_pusher/member",
+        [&] { call_method(L, bound_member, self, top); },
+        [&] { call_method(L, raw_member, self, top); });
+
+    bench.run("call/function_pusher/member",
+        [&] { call_method(L, fixed_member, self, top); },
+        [&] { call_method(L, raw_member, self, top); });
+
+    bench.run("call/function_pusher/member/unchecked",
+        [&] { call_method(L, unchecked_member, self, top); },
+        [&] { call_method(L, raw_member, self, top); });
+
+    lua_pushcfunction(L, raw_new);
+    auto raw_ctor = lua_gettop(L);
+
+    detail::constructor_pusher<Point, int, int>::push(L);
+    auto ctor = lua_gettop(L);
+
+    top = lua_gettop(L);
+
+    bench.run("call/constructor_pusher",
+        [&] { call2(L, ctor, top); },
+        [&] { call2(L, raw_ctor, top); });
+}
+
+// one element of a large member, read through a proxy against copying
+// the whole container into a table first
+void bench_proxies(Bench& bench, lua_State* L)
+{
+    using namespace Lua;
+
+    Pop pop(L);
+
+    std::vector<double> big(50000, 4.2);
+    auto top = lua_gettop(L);
+
+    bench.run("index/container_proxy", 1000,
+        [&]
+        {
+            util::container_proxy<std::vector<double>>::push(L, big);
+            lua_pushinteger(L, 25000);
+            lua_gettable(L, -2);
+            consume(lua_tonumber(L, -1));
+            lua_settop(L, top);
+        },
+        [&]
+        {
+            stack::push(L, big);
+            lua_rawgeti(L, -1, 25000);
+            consume(lua_tonumber(L, -1));
+            lua_settop(L, top);
+        });
+}
+
+// b.x through the class's __index against b:get_x(), a hand-written
+// getter found in the methods table
+void bench_properties(Bench& bench, lua_State* L)
+{
+    using namespace Lua;
+
+    Pop pop(L);
+
+    registration::Editor<Body>(L, "Body")
+        .add_property("x", &Body::x)
+        .add_property("y", &Body::y)
+        .finish();
+
+    lua_getglobal(L, "Body");
+    lua_pushliteral(L, "get_x");
+    lua_pushcfunction(L, raw_get_x);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    util::userdata<Body>::emplace(L, 1, 2);
+    util::userdata<Body>::assign_metatable(L, -1);
+    auto b = lua_gettop(L);
+
+    bench.run("index/property",
+        [&]
+        {
+            lua_getfield(L, b, "x");
+            consume(lua_tointeger(L, -1));
+            lua_pop(L, 1);
+        },
+        [&]
+        {
+            lua_getfield(L, b, "get_x");
+            lua_pushvalue(L, b);
+            lua_call(L, 1, 1);
+            consume(lua_tointeger(L, -1));
+            lua_pop(L, 1);
+        });
+}
+
+// a hot Lua loop calling a bound function; an FFI export can be compiled
+// into the loop's trace, a lua_CFunction can't
+void bench_traces(Bench& bench, lua_State* L)
+{
+    using namespace Lua;
+
+    Pop pop(L);
+
+    luaL_loadstring(L,
+        "local f = ...\n"
+        "local s = 0\n"
+        "for i = 1, 1000 do s = f(s, i) end\n"
+        "return s");
+    auto loop = lua_gettop(L);
+
+    detail::ffi_pusher<decltype(&add), &add>::push(L);
+    auto exported = lua_gettop(L);
+
+    lua_pushcfunction(L, raw_add);
+    auto raw = lua_gettop(L);
+
+    auto top = lua_gettop(L);
+
+    auto run_loop = [&](int f)
+    {
+        lua_pushvalue(L, loop);
+        lua_pushvalue(L, f);
+        lua_call(L, 1, 1);
+        consume(lua_tointeger(L, -1));
+        lua_settop(L, top);
+    };
+
+    bench.run("loop/ffi_export", 1000,
+        [&] { run_loop(exported); },
+        [&] { run_loop(raw); });
+
+    // the same loop creating an object per iteration: an FFI value type
+    // against Point's boxed userdata
+    register_value<Point>(L, "PointValue")
+        .add_field("x", &Point::x)
+        .add_field("y", &Point::y)
+        .add_method<decltype(&Point::sum), &Point::sum>("sum")
+        .finish();
+
+    lua_getglobal(L, "PointValue");
+    auto value_type = lua_gettop(L);
+
+    lua_getglobal(L, "Point");
+    lua_getfield(L, -1, "new");
+    auto boxed_new = lua_gettop(L);
+
+    luaL_loadstring(L,
+        "local new = ...\n"
+        "local s = 0\n"
+        "for i = 1, 1000 do s = s + new(i, i):sum(1, 2) end\n"
+        "return s");
+    loop = lua_gettop(L);
+
+    lua_getglobal(L, "Point");
+    lua_pushliteral(L, "sum");
+    detail::function_pusher<decltype(&Point::sum), &Point::sum>::push(L);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    top = lua_gettop(L);
+
+    bench.run("loop/ffi_value", 1000,
+        [&] { run_loop(value_type); },
+        [&] { run_loop(boxed_new); });
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    long iterations = ( argc > 1 ) ? std::atol(argv[1]) : 1000000;
+    if ( iterations <= 0 )
+    {
+        std::fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    State lua;
+
+    Lua::registration::Editor<Point>(lua, "Point")
+        .add_ctor<int, int>()
+        .finish();
+
+    Bench bench(iterations);
+
+    bench_stack(bench, lua);
+    bench_calls(bench, lua);
+    bench_proxies(bench, lua);
+    bench_properties(bench, lua);
+    bench_traces(bench, lua);
+
+    bench.report(stdout);
+    return 0;
+}
@@ -52,15 +52,17 @@ template<int N, typename Return, typename... Pack>
 struct functor_applier
 {
     template<typename Getter, typename F, typename... Args>
-    static Return apply(Getter&, F fn, Args&&... args)
+    static Return apply(Getter&, F&& fn, Args&&... args)
     { return fn(std::forward<Args>(args)...); }
 };
 
 template<int N, typename Return, typename Next, typename... Pack>
 struct functor_applier<N, Return, Next, Pack...>
 {
+    // fn is passed by reference all the way down, so function objects
+    // are never copied
     template<typename Getter, typename F, typename... Args>
-    static Return apply(Getter& getter, F fn, Args&&... args)
+    static Return apply(Getter& getter, F&& fn, Args&&... args)
     {
         return functor_applier<N+1, Return, Pack...>::apply(getter, fn,
             std::forward<Args>(args)..., getter.template get<Next>(N));
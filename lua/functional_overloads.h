@@ -0,0 +1,281 @@
+#pragma once
+
+#include <algorithm>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "functional_pushers.h"
+
+// overload sets: several signatures bound under one name. the candidate is
+// picked by a decision tree generated at compile time, first on the number
+// of arguments, the most of those given that any candidate takes, and then
+// on the Lua types of only those arguments that tell candidates of the
+// same arity apart. candidates are never tried and rolled back, so
+// resolution never throws.
+
+namespace Lua
+{
+
+namespace detail
+{
+
+template<typename... Ts>
+struct type_list
+{ static constexpr int size = sizeof...(Ts); };
+
+template<int K, typename List>
+struct nth {};
+
+template<int K, typename T, typename... Ts>
+struct nth<K, type_list<T, Ts...>>
+{ using type = typename nth<K-1, type_list<Ts...>>::type; };
+
+template<typename T, typename... Ts>
+struct nth<0, type_list<T, Ts...>>
+{ using type = T; };
+
+// the lua_type of a builtin or container argument; two numeric parameters, for
+// instance, can't be told apart
+template<int code>
+struct lua_type_key
+{
+    static bool match(lua_State* L, int n)
+    { return lua_type(L, n) == code; }
+};
+
+// what the dispatcher compares for a parameter of type T; user objects
+// are told apart by their metatables
+template<typename T, typename = void>
+struct arg_key
+{
+    using type = arg_key<typename util::base<T>::type>;
+
+    static bool match(lua_State* L, int n)
+    { return stack::is<T>(L, n); }
+};
+
+template<typename T>
+struct arg_key<T, util::enable_for<
+    util::is_builtin<typename std::decay<T>::type>() or
+    util::is_enum<typename std::decay<T>::type>() or
+    util::is_container<typename std::decay<T>::type>()>>
+{
+    using type = lua_type_key<
+        traits::lua_type_code<typename std::decay<T>::type>::value>;
+
+    static bool match(lua_State* L, int n)
+    { return type::match(L, n); }
+};
+
+template<int K, typename Args>
+using key_at = typename arg_key<typename nth<K, Args>::type>::type;
+
+// does parameter K of A differ from that of B, when both take as many
+// arguments?
+template<int K, typename A, typename B, bool = A::size == B::size>
+struct differs : std::false_type {};
+
+template<int K, typename A, typename B>
+struct differs<K, A, B, true> :
+    std::integral_constant<bool, !std::is_same<key_at<K, A>, key_at<K, B>>::value> {};
+
+// is argument K worth probing to choose between Args and the Later
+// candidates?
+template<int K, typename Args, typename... Later>
+struct discriminates : std::false_type {};
+
+template<int K, typename Args, typename Next, typename... Later>
+struct discriminates<K, Args, Next, Later...> :
+    std::integral_constant<bool, differs<K, Args, Next>::value or
+        discriminates<K, Args, Later...>::value> {};
+
+// probes arguments [K, Args::size); an argument that fails a check nothing
+// depends on is reported by the candidate itself as a TypeError
+template<int K, typename Args, bool, typename... Later>
+struct arg_matcher
+{
+    static bool match(lua_State* L)
+    {
+        if ( discriminates<K, Args, Later...>::value and
+            !arg_key<typename nth<K, Args>::type>::match(L, K + 1) )
+            return false;
+
+        return arg_matcher<K+1, Args, K+1 == Args::size, Later...>::match(L);
+    }
+};
+
+template<int K, typename Args, typename... Later>
+struct arg_matcher<K, Args, true, Later...>
+{
+    static bool match(lua_State*)
+    { return true; }
+};
+
+// the decision tree over the candidates taking exactly arity arguments:
+// Cs are the candidates from index I of Set onwards
+template<typename Policy, typename Set, int I, typename... Cs>
+struct overload_dispatcher
+{
+    static bool dispatch(lua_State*, int, Set&, int&)
+    { return false; }
+};
+
+template<typename Policy, typename Set, int I, typename C, typename... Cs>
+struct overload_dispatcher<Policy, Set, I, C, Cs...>
+{
+    static bool dispatch(lua_State* L, int arity, Set& set, int& results)
+    {
+        using Args = typename C::args;
+
+        if ( arity == Args::size and
+            arg_matcher<0, Args, Args::size == 0, typename Cs::args...>::match(L) )
+        {
+            results = std::get<I>(set).template call<Policy>(L);
+            return true;
+        }
+
+        return overload_dispatcher<Policy, Set, I+1, Cs...>::
+            dispatch(L, arity, set, results);
+    }
+};
+
+template<typename... Cs>
+struct max_arity : std::integral_constant<int, 0> {};
+
+template<typename C, typename... Cs>
+struct max_arity<C, Cs...> : std::integral_constant<int,
+    ( C::args::size > max_arity<Cs...>::value ) ?
+        C::args::size : max_arity<Cs...>::value> {};
+
+// extra arguments are ignored, as they are by single bindings: the
+// candidates taking the most of the arguments given are tried first
+template<typename Policy, typename Set, typename... Cs>
+inline int dispatch_overload(lua_State* L, Set& set)
+{
+    int argc = lua_gettop(L);
+    int results = 0;
+
+    for ( int arity = std::min(argc, max_arity<Cs...>::value); arity >= 0; --arity )
+    {
+        if ( overload_dispatcher<Policy, Set, 0, Cs...>::
+            dispatch(L, arity, set, results) )
+            return results;
+    }
+
+    return luaL_error(L, "ArityError: no overload takes %d argument%s", argc,
+        argc == 1 ? "" : "s");
+}
+
+// a candidate function; holds the pointer it was bound with
+template<typename F>
+struct overload {};
+
+template<typename Return, typename... Args>
+struct overload<Return(*)(Args...)>
+{
+    using args = type_list<Args...>;
+
+    Return(*fn)(Args...);
+
+    Return operator()(Args... args) const
+    { return fn(std::forward<Args>(args)...); }
+
+    template<typename Policy>
+    int call(lua_State* L)
+    { return proxy_outer<Return, Args...>::template proxy<Policy>(L, *this); }
+};
+
+template<typename Return, typename Class, typename... Args>
+struct overload<Return(Class::*)(Args...)>
+{
+    using args = type_list<Class&, Args...>;
+
+    Return(Class::*fn)(Args...);
+
+    Return operator()(Class& self, Args... args) const
+    { return (self.*fn)(std::forward<Args>(args)...); }
+
+    template<typename Policy>
+    int call(lua_State* L)
+    {
+        return proxy_outer<Return, Class&, Args...>::template
+            proxy<Policy>(L, *this);
+    }
+};
+
+template<typename Return, typename Class, typename... Args>
+struct overload<Return(Class::*)(Args...) const>
+{
+    using args = type_list<Class&, Args...>;
+
+    Return(Class::*fn)(Args...) const;
+
+    Return operator()(Class& self, Args... args) const
+    { return (self.*fn)(std::forward<Args>(args)...); }
+
+    template<typename Policy>
+    int call(lua_State* L)
+    {
+        return proxy_outer<Return, Class&, Args...>::template
+            proxy<Policy>(L, *this);
+    }
+};
+
+// a candidate constructor, given as a signature such as void(int, int)
+template<typename Class, typename Sig>
+struct ctor_overload {};
+
+template<typename Class, typename... Args>
+struct ctor_overload<Class, void(Args...)>
+{
+    using args = type_list<Args...>;
+
+    template<typename Policy>
+    int call(lua_State* L)
+    { return constructor_pusher<Class, Args...>::template proxy<Policy>(L); }
+};
+
+// the bound pointers are kept together in one upvalue
+template<typename... Fs>
+struct overload_pusher
+{
+    using Set = std::tuple<overload<Fs>...>;
+
+    template<typename Policy>
+    static int proxy(lua_State* L)
+    {
+        auto& set = util::gc_object::cast<Set>(L, lua_upvalueindex(1));
+        return dispatch_overload<Policy, Set, overload<Fs>...>(L, set);
+    }
+
+    template<typename Policy = policy::checked>
+    static void push(lua_State* L, Fs... fns)
+    {
+        Set set(overload<Fs> { fns }...);
+        util::gc_object::push(L, set);
+        lua_pushcclosure(L, proxy<Policy>, 1);
+    }
+};
+
+template<typename Class, typename... Sigs>
+struct ctor_overload_pusher
+{
+    using Set = std::tuple<ctor_overload<Class, Sigs>...>;
+
+    template<typename Policy>
+    static int proxy(lua_State* L)
+    {
+        Set set;
+        return dispatch_overload<Policy, Set,
+            ctor_overload<Class, Sigs>...>(L, set);
+    }
+
+    template<typename Policy = policy::checked>
+    static void push(lua_State* L)
+    { lua_pushcfunction(L, proxy<Policy>); }
+};
+
+} // namespace detail
+
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 #include "functional_appliers.h"
 #include "lua_gcobject.h"
@@ -12,20 +15,199 @@ namespace Lua
 namespace util
 {
 
+// builtins and containers taken as const T& are read into a temporary T,
+// which lives until the bound function returns
+template<typename T>
+using arg_type = typename std::conditional<
+    std::is_lvalue_reference<T>::value and
+        std::is_const<typename std::remove_reference<T>::type>::value and
+        !is_user<T>(),
+    typename std::decay<T>::type,
+    T
+>::type;
+
+// user objects taken as T& or const T& refer straight to the object held
+// by the userdata. a by-value T is copied once into a temporary and then
+// moved into the parameter; define LUA_SHIM_STRICT_USER_ARGS to reject
+// by-value user parameters at compile time instead. both getters go
+// through check_arg, so trusted bindings are held to it as well
+template<typename T>
+inline void check_arg()
+{
+#ifdef LUA_SHIM_STRICT_USER_ARGS
+    static_assert(!is_user_object<T>(),
+        "user objects must be taken by reference or pointer");
+#endif
+}
+
 struct Getter
 {
     lua_State* L;
 
     template<typename T>
-    T get(int n)
-    { return stack::getx<T>(L, n); }
+    arg_type<T> get(int n)
+    {
+        check_arg<T>();
+        return stack::getx<arg_type<T>>(L, n);
+    }
+};
+
+// for trusted callers: arguments are cast without any checks
+struct UncheckedGetter
+{
+    lua_State* L;
+
+    template<typename T>
+    arg_type<T> get(int n)
+    {
+        check_arg<T>();
+        return stack::cast<arg_type<T>>(L, n);
+    }
+};
+
+// constructs a Class inline in a new userdata block on top of the stack
+template<typename Class>
+struct Emplacer
+{
+    lua_State* L;
+
+    template<typename... Args>
+    Class* operator()(Args&&... args)
+    { return userdata<Class>::emplace(L, std::forward<Args>(args)...); }
 };
 
 } // namespace util
 
+namespace policy
+{
+
+// arguments are counted and type checked; mismatches raise Lua errors
+struct checked
+{
+    using getter = util::Getter;
+    static constexpr bool check_arity = true;
+};
+
+// arguments are cast as is. only for bindings whose callers are known to
+// pass the right arguments, e.g. generated code; anything else is
+// undefined behavior
+struct unchecked
+{
+    using getter = util::UncheckedGetter;
+    static constexpr bool check_arity = false;
+};
+
+// unchecked in release builds, checked when NDEBUG isn't defined
+#ifdef NDEBUG
+using trusted = unchecked;
+#else
+using trusted = checked;
+#endif
+
+} // namespace policy
+
 namespace detail
 {
 
+// pushes elements [I, N) of a tuple or pair
+template<size_t I, size_t N>
+struct element_pusher
+{
+    template<typename Tuple>
+    static void push(lua_State* L, Tuple&& t)
+    {
+        stack::push(L, std::get<I>(std::forward<Tuple>(t)));
+        element_pusher<I+1, N>::push(L, std::forward<Tuple>(t));
+    }
+};
+
+template<size_t N>
+struct element_pusher<N, N>
+{
+    template<typename Tuple>
+    static void push(lua_State*, Tuple&&) { }
+};
+
+// pushes the result of a bound call and returns the number of values
+// pushed; count is the number reserved up front
+template<typename Return>
+struct result_pusher
+{
+    static constexpr int count = 1;
+
+    template<typename R>
+    static int push(lua_State* L, R&& ret)
+    {
+        stack::push(L, std::forward<R>(ret));
+        return 1;
+    }
+};
+
+// tuples and pairs are returned as multiple values
+template<typename... Ts>
+struct result_pusher<std::tuple<Ts...>>
+{
+    static constexpr int count = sizeof...(Ts);
+
+    template<typename R>
+    static int push(lua_State* L, R&& ret)
+    {
+        element_pusher<0, count>::push(L, std::forward<R>(ret));
+        return count;
+    }
+};
+
+template<typename First, typename Second>
+struct result_pusher<std::pair<First, Second>>
+{
+    static constexpr int count = 2;
+
+    template<typename R>
+    static int push(lua_State* L, R&& ret)
+    {
+        element_pusher<0, count>::push(L, std::forward<R>(ret));
+        return count;
+    }
+};
+
+template<>
+struct result_pusher<void>
+{ static constexpr int count = 0; };
+
+// a C function starts out with LUA_MINSTACK free slots. conversions and
+// user object pushes use up to scratch_slots more on top of the results,
+// so the stack only has to grow for calls returning many values.
+// containers reserve room for their own contents, level by level
+constexpr int scratch_slots = 2;
+
+template<int N>
+inline void reserve_results(lua_State* L)
+{
+    if ( N + scratch_slots > LUA_MINSTACK )
+        luaL_checkstack(L, N + scratch_slots, "too many results");
+}
+
+__attribute__((noinline))
+inline int arity_error(lua_State* L, int expected, int actual)
+{
+    lua_pushfstring(L, "ArityError: expected %d argument%s, got %d",
+        expected, expected == 1 ? "" : "s", actual);
+
+    return lua_error(L);
+}
+
+// validates the argument count once, so the conversions never see a
+// 'none' slot, and reserves stack for the results before the call. extra
+// arguments are ignored, as with any Lua function
+template<int arity, int results>
+inline void prepare_call(lua_State* L)
+{
+    if ( arity > 0 and lua_gettop(L) < arity )
+        arity_error(L, arity, lua_gettop(L));
+
+    reserve_results<results>(L);
+}
+
 // have to break this out of method_pusher to specialize on return type :(
 template<typename Return, typename... Args>
 struct proxy_inner
@@ -33,9 +215,9 @@ struct proxy_inner
     template<typename Getter, typename Func>
     static int proxy(lua_State* L, Getter& getter, Func& func)
     {
-        auto ret = functor_applier<1, Return, Args...>::apply(getter, func);
-        stack::push(L, ret);
-        return 1;
+        // returned objects are moved straight into place
+        return result_pusher<typename std::decay<Return>::type>::push(L,
+            functor_applier<1, Return, Args...>::apply(getter, func));
     }
 };
 
@@ -50,70 +232,172 @@ struct proxy_inner<void, Args...>
     }
 };
 
+// runs body, turning a thrown TypeError into a Lua error. when type
+// errors are raised as Lua errors this is a plain call, with no landing
+// pad in the proxy
+template<typename Body>
+inline int protect(lua_State* L, Body&& body)
+{
+#ifdef LUA_SHIM_RAISE_TYPE_ERRORS
+    (void)L;
+    return body();
+#else
+    try
+    {
+        return body();
+    }
+
+    catch ( TypeError& e )
+    {
+        e.push(L);
+    }
+
+    // wait until the catch block exits before calling lua_error
+    // to ensure stack cleanup
+    lua_error(L);
+
+    // because the compiler doesn't know that lua_error does a long jump
+    return 0;
+#endif
+}
+
+// common entry point for bound calls
+template<typename Return, typename... Args>
+struct proxy_outer
+{
+    template<typename Policy, typename Func>
+    static int proxy(lua_State* L, Func& func)
+    {
+        prepare_call<Policy::check_arity ? sizeof...(Args) : 0,
+            result_pusher<typename std::decay<Return>::type>::count>(L);
+
+        return protect(L, [L, &func]
+        {
+            typename Policy::getter getter { L };
+            return proxy_inner<Return, Args...>::proxy(L, getter, func);
+        });
+    }
+};
+
 template<typename Return, typename... Args>
 struct method_pusher
 {
     using Func = std::function<Return(Args...)>;
 
+    template<typename Policy>
     static int proxy(lua_State* L)
     {
-        try
-        {
-            util::Getter getter { L };
-            auto func = util::gc_object::cast<Func>(L, lua_upvalueindex(1));
-            return proxy_inner<Return, Args...>::proxy(L, getter, func);
-        }
+        // by reference: copying a std::function may allocate
+        auto& func = util::gc_object::cast<Func>(L, lua_upvalueindex(1));
+        return proxy_outer<Return, Args...>::template proxy<Policy>(L, func);
+    }
 
-        catch ( TypeError& e )
-        {
-            stack::push(L, e.what());
-        }
+    template<typename Policy = policy::checked>
+    static void push(lua_State* L, Func func)
+    {
+        util::gc_object::push(L, func);
+        lua_pushcclosure(L, proxy<Policy>, 1);
+    }
+};
 
-        // wait until the catch block exits before calling lua_error
-        // to ensure stack cleanup
-        lua_error(L);
+// binds a function known at compile time: each function gets its own
+// lua_CFunction with no upvalue and no type erasure, so the callee can be
+// inlined into the proxy
+template<typename F, F fn>
+struct function_pusher {};
 
-        // because the compiler doesn't know that lua_error does a long jump
-        return 0;
+// function pointer
+template<typename Return, typename... Args, Return(*fn)(Args...)>
+struct function_pusher<Return(*)(Args...), fn>
+{
+    struct Invoker
+    {
+        Return operator()(Args... args) const
+        { return fn(std::forward<Args>(args)...); }
+    };
+
+    template<typename Policy>
+    static int proxy(lua_State* L)
+    {
+        Invoker func;
+        return proxy_outer<Return, Args...>::template proxy<Policy>(L, func);
     }
 
-    static void push(lua_State* L, Func func)
+    template<typename Policy = policy::checked>
+    static void push(lua_State* L)
+    { lua_pushcfunction(L, proxy<Policy>); }
+};
+
+// member function pointer
+template<typename Return, typename Class, typename... Args,
+    Return(Class::*fn)(Args...)>
+struct function_pusher<Return(Class::*)(Args...), fn>
+{
+    struct Invoker
     {
-        util::gc_object::push(L, func);
-        lua_pushcclosure(L, proxy, 1);
+        Return operator()(Class& self, Args... args) const
+        { return (self.*fn)(std::forward<Args>(args)...); }
+    };
+
+    template<typename Policy>
+    static int proxy(lua_State* L)
+    {
+        Invoker func;
+        return proxy_outer<Return, Class&, Args...>::template proxy<Policy>(L, func);
+    }
+
+    template<typename Policy = policy::checked>
+    static void push(lua_State* L)
+    { lua_pushcfunction(L, proxy<Policy>); }
+};
+
+// const member function pointer
+template<typename Return, typename Class, typename... Args,
+    Return(Class::*fn)(Args...) const>
+struct function_pusher<Return(Class::*)(Args...) const, fn>
+{
+    struct Invoker
+    {
+        Return operator()(Class& self, Args... args) const
+        { return (self.*fn)(std::forward<Args>(args)...); }
+    };
+
+    template<typename Policy>
+    static int proxy(lua_State* L)
+    {
+        Invoker func;
+        return proxy_outer<Return, Class&, Args...>::template proxy<Policy>(L, func);
     }
+
+    template<typename Policy = policy::checked>
+    static void push(lua_State* L)
+    { lua_pushcfunction(L, proxy<Policy>); }
 };
 
 template<typename Class, typename... Args>
 struct constructor_pusher
 {
+    template<typename Policy>
     static int proxy(lua_State* L)
     {
-        try
-        {
-            util::Getter getter { L };
-            auto inst = new_applier<1, Class, Args...>::apply(getter);
-            util::userdata<Class>::push(L, *inst);
-            util::userdata<Class>::assign_metatable(L, -1);
-            return 1;
-        }
+        prepare_call<Policy::check_arity ? sizeof...(Args) : 0, 1>(L);
 
-        catch ( TypeError& e )
+        return protect(L, [L]
         {
-            stack::push(L, e.what());
-        }
+            typename Policy::getter getter { L };
 
-        // wait until the catch block exits before calling lua_error
-        // to ensure stack cleanup
-        lua_error(L);
+            // construct directly inside the userdata block
+            functor_applier<1, Class*, Args...>::apply(getter,
+                util::Emplacer<Class> { L });
 
-        // since the compiler doesn't know that lua_error()
-        // does a long jump
-        return 0;
+            util::userdata<Class>::assign_metatable(L, -1);
+            return 1;
+        });
     }
 
+    template<typename Policy = policy::checked>
     static void push(lua_State* L)
-    { lua_pushcfunction(L, proxy); }
+    { lua_pushcfunction(L, proxy<Policy>); }
 };
 
 template<typename Class>
@@ -121,25 +405,12 @@ struct destructor_pusher
 {
     static int proxy(lua_State* L)
     {
-        try
+        return protect(L, [L]
         {
             stack::check<Class>(L, 1);
             util::userdata<Class>::destroy(L, 1);
             return 0;
-        }
-
-        catch ( TypeError& e )
-        {
-            stack::push(L, e.what());
-        }
-
-        // wait until the catch block exits before calling lua_error
-        // to ensure stack cleanup
-        lua_error(L);
-
-        // since the compiler doesn't know that lua_error()
-        // does a long jump
-        return 0;
+        });
     }
 
     static void push(lua_State* L)
@@ -153,60 +424,67 @@ struct auto_pusher {};
 template<typename Return, typename... Args>
 struct auto_pusher<Return(*)(Args...)>
 {
-    template<typename F>
+    template<typename Policy = policy::checked, typename F>
     static void push(lua_State* L, F fn)
-    { method_pusher<Return, Args...>::push(L, fn); }
+    { method_pusher<Return, Args...>::template push<Policy>(L, fn); }
 };
 
 // function
 template<typename Return, typename... Args>
 struct auto_pusher<Return(Args...)>
 {
-    template<typename F>
+    template<typename Policy = policy::checked, typename F>
     static void push(lua_State* L, F fn)
-    { method_pusher<Return, Args...>::push(L, fn); }
+    { method_pusher<Return, Args...>::template push<Policy>(L, fn); }
 };
 
 // member function pointer
 template<typename Return, typename Class, typename... Args>
 struct auto_pusher<Return(Class::*)(Args...)>
 {
-    template<typename F>
+    template<typename Policy = policy::checked, typename F>
     static void push(lua_State* L, F fn)
-    { method_pusher<Return, Class&, Args...>::push(L, std::mem_fn(fn)); }
+    {
+        method_pusher<Return, Class&, Args...>::template
+            push<Policy>(L, std::mem_fn(fn));
+    }
 };
 
 // const member function pointer
 template<typename Return, typename Class, typename... Args>
 struct auto_pusher<Return(Class::*)(Args...) const>
 {
-    template<typename F>
+    template<typename Policy = policy::checked, typename F>
     static void push(lua_State* L, F fn)
-    { method_pusher<Return, Class&, Args...>::push(L, std::mem_fn(fn)); }
+    {
+        method_pusher<Return, Class&, Args...>::template
+            push<Policy>(L, std::mem_fn(fn));
+    }
 };
 
 // function object
 template<typename Return, typename... Args>
 struct auto_pusher<std::function<Return(Args...)>>
 {
-    template<typename F>
+    template<typename Policy = policy::checked, typename F>
     static void push(lua_State* L, F fn)
-    { method_pusher<Return, Args...>::push(L, fn); }
+    { method_pusher<Return, Args...>::template push<Policy>(L, fn); }
 };
 
 // const function object
 template<typename Return, typename... Args>
 struct auto_pusher<const std::function<Return(Args...)>>
 {
-    template<typename F>
+    template<typename Policy = policy::checked, typename F>
     static void push(lua_State* L, F fn)
-    { method_pusher<Return, Args...>::push(L, fn); }
+    { method_pusher<Return, Args...>::template push<Policy>(L, fn); }
 };
 
 // raw lua cfunction pointer
 template<>
 struct auto_pusher<lua_CFunction>
 {
+    template<typename Policy = policy::checked>
     static void push(lua_State* L, lua_CFunction fn)
     { lua_pushcfunction(L, fn); }
 };
@@ -215,6 +493,7 @@ struct auto_pusher<lua_CFunction>
 template<>
 struct auto_pusher<int(lua_State*)>
 {
+    template<typename Policy = policy::checked>
     static void push(lua_State* L, lua_CFunction fn)
     { lua_pushcfunction(L, fn); }
 };
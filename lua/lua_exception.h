@@ -1,8 +1,25 @@
 #pragma once
 
-#include <sstream>
+#include <cstdio>
+#include <exception>
 #include <string>
 
+#include <luajit-2.0/lua.hpp>
+
+// error handling modes, chosen at build time:
+//
+// - by default type errors are thrown as TypeError and every proxy turns
+//   them into Lua errors.
+// - LUA_SHIM_LUAJIT_UNWIND: for LuaJIT builds that unwind C++ frames (x64).
+//   type errors go straight to lua_error, which still runs destructors,
+//   so proxies carry no try/catch. other exceptions thrown by bound code
+//   are translated once, at the boundary set up by set_exception_boundary.
+// - LUA_SHIM_NO_EXCEPTIONS: type errors go straight to lua_error, for code
+//   built without exceptions.
+#if defined(LUA_SHIM_LUAJIT_UNWIND) || defined(LUA_SHIM_NO_EXCEPTIONS)
+#define LUA_SHIM_RAISE_TYPE_ERRORS
+#endif
+
 namespace Lua
 {
 
@@ -13,26 +30,86 @@ public:
     virtual std::string what() const = 0;
 };
 
+// holds no strings of its own: the type names are string constants, or
+// registered names that outlive the call raising the error
 class TypeError : public Exception
 {
 public:
-    TypeError(int index, std::string expected, std::string actual) :
+    TypeError(int index, const char* expected, const char* actual) :
         index(index), expected(expected), actual(actual) { }
 
     std::string what() const override
     {
-        std::ostringstream os;
-        os << "TypeError: (arg #" << index << ")" <<
-            " expected '" << expected << "'" <<
-            ", got '" << actual << "'";
+        char buf[256];
+        std::snprintf(buf, sizeof(buf), format(), index, expected, actual);
+        return buf;
+    }
+
+    // formats the message straight into the Lua string pool
+    void push(lua_State* L) const
+    { lua_pushfstring(L, format(), index, expected, actual); }
 
-        return os.str();
+    // does not return
+    void raise(lua_State* L) const
+    {
+        push(L);
+        lua_error(L);
     }
 
 private:
+    static const char* format()
+    { return "TypeError: (arg #%d) expected '%s', got '%s'"; }
+
     int index;
-    std::string expected;
-    std::string actual;
+    const char* expected;
+    const char* actual;
 };
 
+namespace detail
+{
+
+// LuaJIT errors are not caught here: they unwind as foreign exceptions.
+// without exceptions there is nothing to translate
+inline int exception_boundary(lua_State* L, lua_CFunction f)
+{
+#ifdef LUA_SHIM_NO_EXCEPTIONS
+    return f(L);
+#else
+    try
+    {
+        return f(L);
+    }
+
+    catch ( const Exception& e )
+    {
+        lua_pushstring(L, e.what().c_str());
+    }
+
+    catch ( const std::exception& e )
+    {
+        lua_pushstring(L, e.what());
+    }
+
+    catch ( const char* s )
+    {
+        lua_pushstring(L, s);
+    }
+
+    // wait until the catch block exits before calling lua_error
+    return lua_error(L);
+#endif
+}
+
+} // namespace detail
+
+// routes every C function called from L through one handler that turns
+// C++ exceptions into Lua errors; returns false if LuaJIT refused
+inline bool set_exception_boundary(lua_State* L)
+{
+    lua_pushlightuserdata(L, reinterpret_cast<void*>(detail::exception_boundary));
+    bool ok = luaJIT_setmode(L, -1, LUAJIT_MODE_WRAPCFUNC | LUAJIT_MODE_ON);
+    lua_pop(L, 1);
+    return ok;
+}
+
 }
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "functional_pushers.h"
+
+// LuaJIT FFI exports: compile-time bindings with plain C signatures are
+// pushed as FFI function pointers instead of lua_CFunctions, so the JIT
+// can compile calls to them into traces rather than leaving them to the
+// interpreter
+
+namespace Lua
+{
+
+namespace policy
+{
+
+// exports what it can through the FFI and binds everything else like
+// policy::checked, which is also the fallback when the FFI isn't loaded.
+// exported functions bypass the shim entirely, so only free functions
+// taking and returning numbers are exported: the FFI converts and checks
+// those itself. methods keep the checks on self, and exported functions
+// have to be noexcept
+struct ffi : checked {};
+
+} // namespace policy
+
+namespace util
+{
+
+// C declarations for the FFI; integers are spelled by size, as the
+// stdint.h names the FFI knows without a cdef
+template<typename T, typename = void>
+struct ctype {};
+
+template<>
+struct ctype<void>
+{
+    static std::string name()
+    { return "void"; }
+};
+
+template<>
+struct ctype<bool>
+{
+    static std::string name()
+    { return "bool"; }
+};
+
+template<>
+struct ctype<float>
+{
+    static std::string name()
+    { return "float"; }
+};
+
+template<>
+struct ctype<double>
+{
+    static std::string name()
+    { return "double"; }
+};
+
+template<typename T>
+struct ctype<T, enable_for<std::is_integral<T>::value and !is_bool<T>()>>
+{
+    static std::string name()
+    {
+        return std::string(std::is_signed<T>::value ? "int" : "uint") +
+            std::to_string(8 * sizeof(T)) + "_t";
+    }
+};
+
+template<typename T>
+struct ctype<T, enable_for<std::is_enum<T>::value>>
+{
+    static std::string name()
+    { return ctype<typename std::underlying_type<T>::type>::name(); }
+};
+
+// no strings: the FFI passes nil as a null const char*, which an
+// exported function couldn't report as an error
+template<typename T>
+constexpr bool is_ffi_arg()
+{
+    return ( std::is_arithmetic<T>::value and
+            !std::is_same<T, long double>::value ) or
+        std::is_enum<T>::value;
+}
+
+// the FFI boxes 64-bit integers and pointers in cdata on the way back,
+// where a lua_CFunction would return plain numbers and strings
+template<typename T, typename = void>
+struct small_int : std::false_type {};
+
+template<typename T>
+struct small_int<T, enable_for<std::is_integral<T>::value or
+    std::is_enum<T>::value>> :
+    std::integral_constant<bool, sizeof(T) <= sizeof(std::int32_t)> {};
+
+template<typename T>
+constexpr bool is_ffi_return()
+{
+    return std::is_void<T>::value or std::is_floating_point<T>::value or
+        small_int<T>::value;
+}
+
+template<typename... Ts>
+struct all_ffi_args : std::true_type {};
+
+template<typename T, typename... Ts>
+struct all_ffi_args<T, Ts...> : std::integral_constant<bool,
+    is_ffi_arg<T>() and all_ffi_args<Ts...>::value> {};
+
+inline std::string join_ctypes()
+{ return ""; }
+
+template<typename T, typename... Ts>
+inline std::string join_ctypes(T*, Ts*... rest)
+{
+    auto s = ctype<T>::name();
+    if ( sizeof...(rest) )
+        s += ", " + join_ctypes(rest...);
+
+    return s;
+}
+
+// e.g. "int32_t (*)(void *, double)"
+template<typename Return, typename... Args>
+inline std::string function_ctype()
+{
+    auto params = join_ctypes(static_cast<Args*>(nullptr)...);
+    return ctype<Return>::name() + " (*)(" +
+        ( params.empty() ? "void" : params ) + ")";
+}
+
+// pushes the ffi module, or returns false with nothing pushed if it can't
+// be loaded in this state
+inline bool push_ffi(lua_State* L)
+{
+    lua_getglobal(L, "require");
+    if ( !lua_isfunction(L, -1) )
+    {
+        lua_pop(L, 1);
+        return false;
+    }
+
+    lua_pushliteral(L, "ffi");
+    if ( lua_pcall(L, 1, 1, 0) or !lua_istable(L, -1) )
+    {
+        lua_pop(L, 1);
+        return false;
+    }
+
+    return true;
+}
+
+// same for ffi.cast
+inline bool push_ffi_cast(lua_State* L)
+{
+    if ( !push_ffi(L) )
+        return false;
+
+    lua_getfield(L, -1, "cast");
+    lua_remove(L, -2);
+    return true;
+}
+
+} // namespace util
+
+namespace detail
+{
+
+// plain functions with C-compatible signatures. they can't be extern "C"
+// as templates, but C and C++ linkage share the calling convention on the
+// compilers supported here. methods aren't exported: a call through the
+// FFI couldn't check that self is a live object of the right class
+template<typename F, F fn>
+struct ffi_trampoline
+{ static constexpr bool exportable = false; };
+
+template<typename Return, typename... Args, Return(*fn)(Args...)>
+struct ffi_trampoline<Return(*)(Args...), fn>
+{
+    static constexpr bool exportable =
+        util::is_ffi_return<Return>() and util::all_ffi_args<Args...>::value;
+
+    // nothing can be thrown through the FFI's frames
+    static constexpr bool nothrow = noexcept(fn(std::declval<Args>()...));
+
+    static Return call(Args... args) noexcept
+    { return fn(args...); }
+
+    static std::string signature()
+    { return util::function_ctype<Return, Args...>(); }
+};
+
+template<typename F, F fn, bool = ffi_trampoline<F, fn>::exportable>
+struct ffi_pusher
+{
+    // pushes the result of ffi.cast(signature, trampoline)
+    static void push(lua_State* L)
+    {
+        using trampoline = ffi_trampoline<F, fn>;
+
+        static_assert(trampoline::nothrow,
+            "functions exported through the FFI must be noexcept");
+
+        if ( !util::push_ffi_cast(L) )
+        {
+            function_pusher<F, fn>::template push<policy::checked>(L);
+            return;
+        }
+
+        auto sig = trampoline::signature();
+        lua_pushlstring(L, sig.c_str(), sig.size());
+        lua_pushlightuserdata(L, reinterpret_cast<void*>(&trampoline::call));
+        lua_call(L, 2, 1);
+    }
+};
+
+// anything else, e.g. methods, or std::string or user object parameters
+template<typename F, F fn>
+struct ffi_pusher<F, fn, false>
+{
+    static void push(lua_State* L)
+    { function_pusher<F, fn>::template push<policy::checked>(L); }
+};
+
+// pushes fn as an FFI export under policy::ffi, and as a lua_CFunction
+// otherwise
+template<typename F, F fn, typename Policy>
+struct binding_pusher
+{
+    static void push(lua_State* L)
+    { function_pusher<F, fn>::template push<Policy>(L); }
+};
+
+template<typename F, F fn>
+struct binding_pusher<F, fn, policy::ffi>
+{
+    static void push(lua_State* L)
+    { ffi_pusher<F, fn>::push(L); }
+};
+
+} // namespace detail
+
+}
@@ -17,14 +17,18 @@ struct gc_object
         return 0;
     }
 
+    // pushes the metatable shared by every gc_object of type T in this
+    // state, creating it on first use
     template<typename T>
-    static void push(lua_State* L, T& o)
+    static void push_metatable(lua_State* L)
     {
-        static_assert(std::is_copy_constructible<T>::value,
-            "must be copy-constructible");
+        lua_pushlightuserdata(L, meta_key<T>());
+        lua_rawget(L, LUA_REGISTRYINDEX);
 
-        userdata<T>::emplace(L, o);
-        auto n = lua_gettop(L);
+        if ( lua_istable(L, -1) )
+            return;
+
+        lua_pop(L, 1);
 
         lua_newtable(L);
         auto meta = lua_gettop(L);
@@ -33,6 +37,21 @@ struct gc_object
         lua_pushcfunction(L, dtor_proxy<T>);
         lua_rawset(L, meta);
 
+        lua_pushlightuserdata(L, meta_key<T>());
+        lua_pushvalue(L, meta);
+        lua_rawset(L, LUA_REGISTRYINDEX);
+    }
+
+    template<typename T>
+    static void push(lua_State* L, T& o)
+    {
+        static_assert(std::is_copy_constructible<T>::value,
+            "must be copy-constructible");
+
+        userdata<T>::emplace(L, o);
+        auto n = lua_gettop(L);
+
+        push_metatable<T>(L);
         lua_setmetatable(L, n);
     }
 
@@ -44,6 +63,15 @@ struct gc_object
         assert(p);
         return *p;
     }
+
+private:
+    // the address identifies T's metatable in each state's registry
+    template<typename T>
+    static void* meta_key()
+    {
+        static const char k = 0;
+        return const_cast<char*>(&k);
+    }
 };
 
 } // namespace util
@@ -0,0 +1,346 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "functional_pushers.h"
+
+// properties of bound classes, read and written as obj.x from Lua
+
+namespace Lua
+{
+
+namespace util
+{
+
+// called from __index and __newindex, see property_index below
+struct Property
+{
+    virtual ~Property() { }
+
+    // pushes the property of the object at index 1
+    virtual void get(lua_State* L) const = 0;
+
+    // assigns the value at index 3 to the object at index 1; returns false
+    // if the property is read-only
+    virtual bool set(lua_State* L) const = 0;
+};
+
+// the properties of one class, looked up through a perfect hash over the
+// addresses of their names: Lua strings are interned, so a key equal to a
+// name is the same string, at the same address, for as long as the names
+// are pinned. lives in a userdata block, which pins them in its
+// environment table
+class PropertyTable
+{
+public:
+    // pushes a new, empty table
+    static PropertyTable& push(lua_State* L)
+    {
+        auto t = new (lua_newuserdata(L, sizeof(PropertyTable))) PropertyTable;
+
+        lua_pushlightuserdata(L, meta_key());
+        lua_rawget(L, LUA_REGISTRYINDEX);
+
+        if ( !lua_istable(L, -1) )
+        {
+            lua_pop(L, 1);
+            lua_createtable(L, 0, 1);
+
+            lua_pushliteral(L, "__gc");
+            lua_pushcfunction(L, gc);
+            lua_rawset(L, -3);
+
+            lua_pushlightuserdata(L, meta_key());
+            lua_pushvalue(L, -2);
+            lua_rawset(L, LUA_REGISTRYINDEX);
+        }
+
+        lua_setmetatable(L, -2);
+        return *t;
+    }
+
+    static PropertyTable& get(lua_State* L, int n)
+    { return *static_cast<PropertyTable*>(lua_touserdata(L, n)); }
+
+    // replaces any property of the same name; takes effect at build()
+    void add(const char* name, Property* p)
+    {
+        for ( auto& e : entries )
+        {
+            if ( e.name == name )
+            {
+                e.prop.reset(p);
+                return;
+            }
+        }
+
+        entries.push_back({ name, nullptr, std::unique_ptr<Property>(p) });
+    }
+
+    // interns and pins the names, and finds a hash with no collisions for
+    // them; self is the index of this table's userdata
+    void build(lua_State* L, int self)
+    {
+        lua_createtable(L, entries.size(), 0);
+        for ( std::size_t i = 0; i < entries.size(); ++i )
+        {
+            auto& e = entries[i];
+            lua_pushlstring(L, e.name.c_str(), e.name.size());
+            e.key = lua_tostring(L, -1);
+            lua_rawseti(L, -2, i + 1);
+        }
+
+        lua_setfenv(L, self);
+
+        // at most half full; a bigger table makes a fit easy to find
+        unsigned bits = 1;
+        while ( ( std::size_t(1) << bits ) < 2 * entries.size() )
+            ++bits;
+
+        for ( ;; ++bits )
+        {
+            for ( std::uint64_t seed = 1; seed <= 64; ++seed )
+            {
+                if ( fit(bits, mix(seed)) )
+                    return;
+            }
+        }
+    }
+
+    // the property named by the key at n, or nullptr
+    const Property* find(lua_State* L, int n) const
+    {
+        if ( lua_type(L, n) != LUA_TSTRING )
+            return nullptr;
+
+        auto key = lua_tostring(L, n);
+        auto e = slots[slot(key)];
+        return ( e and e->key == key ) ? e->prop.get() : nullptr;
+    }
+
+    std::size_t size() const
+    { return entries.size(); }
+
+private:
+    struct Entry
+    {
+        std::string name;
+        const void* key;
+        std::unique_ptr<Property> prop;
+    };
+
+    std::size_t slot(const void* key) const
+    {
+        auto p = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(key));
+        return static_cast<std::size_t>((p * multiplier) >> shift);
+    }
+
+    bool fit(unsigned bits, std::uint64_t m)
+    {
+        multiplier = m;
+        shift = 64 - bits;
+        slots.assign(std::size_t(1) << bits, nullptr);
+
+        for ( auto& e : entries )
+        {
+            auto& s = slots[slot(e.key)];
+            if ( s )
+                return false;
+
+            s = &e;
+        }
+
+        return true;
+    }
+
+    // splitmix64, made odd
+    static std::uint64_t mix(std::uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return (x ^ (x >> 31)) | 1;
+    }
+
+    static void* meta_key()
+    {
+        static const char k = 0;
+        return const_cast<char*>(&k);
+    }
+
+    static int gc(lua_State* L)
+    {
+        get(L, 1).~PropertyTable();
+        return 0;
+    }
+
+    std::vector<Entry> entries;
+    std::vector<Entry*> slots { nullptr };
+    std::uint64_t multiplier = 1;
+    unsigned shift = 63;
+};
+
+} // namespace util
+
+namespace detail
+{
+
+// the object at index 1 of __index or __newindex, checked against T's
+// metatable, which they keep as upvalue 4: cheaper than looking T's entry
+// up in the type registry on every access
+template<typename T>
+inline T& property_self(lua_State* L)
+{
+    bool ok = lua_type(L, 1) == LUA_TUSERDATA and lua_getmetatable(L, 1);
+    if ( ok )
+    {
+        ok = lua_rawequal(L, -1, lua_upvalueindex(4));
+        lua_pop(L, 1);
+    }
+
+    if ( !ok )
+        stack::type_error<T&>(L, 1);
+
+    return stack::cast<T&>(L, 1);
+}
+
+// a data member; const members are read-only. user objects are handed
+// out by reference, so obj.pos.x = 1 changes obj, and the reference keeps
+// obj alive the way a container proxy does. everything else is copied
+template<typename T, typename M, typename Policy>
+struct member_property : util::Property
+{
+    M T::* member;
+
+    member_property(M T::* member) : member(member) { }
+
+    void get(lua_State* L) const override
+    {
+        T& self = property_self<T>(L);
+        push_member(L, self.*member, std::integral_constant<bool,
+            util::is_user_object<M>() and !std::is_const<M>::value>());
+    }
+
+    bool set(lua_State* L) const override
+    { return assign(L, std::integral_constant<bool, !std::is_const<M>::value>()); }
+
+private:
+    bool assign(lua_State* L, std::true_type) const
+    {
+        T& self = property_self<T>(L);
+        typename Policy::getter getter { L };
+        self.*member = getter.template get<const M&>(3);
+        return true;
+    }
+
+    bool assign(lua_State*, std::false_type) const
+    { return false; }
+
+    static void push_member(lua_State* L, M& m, std::true_type)
+    {
+        stack::push(L, &m);
+
+        lua_createtable(L, 1, 0);
+        lua_pushvalue(L, 1);
+        lua_rawseti(L, -2, 1);
+        lua_setfenv(L, -2);
+    }
+
+    static void push_member(lua_State* L, const M& m, std::false_type)
+    { stack::push(L, m); }
+};
+
+// a const getter, and a setter unless it's nullptr
+template<typename T, typename R, typename SR, typename A, typename Policy>
+struct accessor_property : util::Property
+{
+    R (T::*getter_fn)() const;
+    SR (T::*setter_fn)(A);
+
+    accessor_property(R (T::*g)() const, SR (T::*s)(A)) :
+        getter_fn(g), setter_fn(s) { }
+
+    void get(lua_State* L) const override
+    {
+        const T& self = property_self<T>(L);
+        stack::push(L, (self.*getter_fn)());
+    }
+
+    bool set(lua_State* L) const override
+    {
+        if ( !setter_fn )
+            return false;
+
+        T& self = property_self<T>(L);
+        typename Policy::getter getter { L };
+        (self.*setter_fn)(getter.template get<A>(3));
+        return true;
+    }
+};
+
+// __index and __newindex for classes with properties. upvalue 1 is the
+// methods table, which is checked first, through any __index chain set on
+// it, upvalue 2 the PropertyTable, upvalue 3 the class name and upvalue 4
+// the class's metatable
+
+inline int property_index(lua_State* L)
+{
+    lua_pushvalue(L, 2);
+    lua_rawget(L, lua_upvalueindex(1));
+    if ( !lua_isnil(L, -1) )
+        return 1;
+
+    // the chain is only followed if there is one
+    if ( lua_getmetatable(L, lua_upvalueindex(1)) )
+    {
+        lua_pop(L, 2);
+        lua_pushvalue(L, 2);
+        lua_gettable(L, lua_upvalueindex(1));
+        if ( !lua_isnil(L, -1) )
+            return 1;
+    }
+
+    auto p = util::PropertyTable::get(L, lua_upvalueindex(2)).find(L, 2);
+    if ( !p )
+        return 1;
+
+    lua_pop(L, 1);
+    return protect(L, [L, p]
+    {
+        p->get(L);
+        return 1;
+    });
+}
+
+inline int property_newindex(lua_State* L)
+{
+    auto p = util::PropertyTable::get(L, lua_upvalueindex(2)).find(L, 2);
+    if ( !p )
+    {
+        return luaL_error(L, "%s has no property '%s'",
+            lua_tostring(L, lua_upvalueindex(3)),
+            lua_type(L, 2) == LUA_TSTRING ? lua_tostring(L, 2) : luaL_typename(L, 2));
+    }
+
+    return protect(L, [L, p]
+    {
+        if ( !p->set(L) )
+        {
+            luaL_error(L, "property '%s' of %s is read-only",
+                lua_tostring(L, 2), lua_tostring(L, lua_upvalueindex(3)));
+        }
+
+        return 0;
+    });
+}
+
+} // namespace detail
+
+}
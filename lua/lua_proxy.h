@@ -0,0 +1,275 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "functional_pushers.h"
+#include "lua_gcobject.h"
+
+// lazy views of C++ containers: scripts index the live container instead
+// of a table copy of it, so touching one element costs one element
+
+namespace Lua
+{
+
+namespace util
+{
+
+// elements are copied, user objects included: a pointer into the
+// container would dangle once it reallocates. changes to a copy are
+// written back by assigning it, e.g. local p = v[1]; p.x = 2; v[1] = p.
+// the const E& also takes vector<bool>'s proxy
+template<typename E>
+inline void push_element(lua_State* L, const E& e)
+{ stack::push(L, e); }
+
+// vectors and deques are indexed from 1 like Lua arrays. assigning to
+// #p + 1 appends
+template<typename C>
+struct sequence_access
+{
+    using E = typename C::value_type;
+
+    static void index(lua_State* L, C& c)
+    {
+        if ( lua_type(L, 2) != LUA_TNUMBER )
+        {
+            lua_pushnil(L);
+            return;
+        }
+
+        auto i = lua_tointeger(L, 2);
+        if ( i < 1 or static_cast<std::size_t>(i) > c.size() )
+        {
+            lua_pushnil(L);
+            return;
+        }
+
+        push_element<E>(L, c[i - 1]);
+    }
+
+    static void newindex(lua_State* L, C& c)
+    {
+        auto i = stack::getx<lua_Integer>(L, 2);
+
+        if ( i >= 1 and static_cast<std::size_t>(i) <= c.size() )
+            c[i - 1] = stack::getx<E>(L, 3);
+
+        else if ( static_cast<std::size_t>(i) == c.size() + 1 )
+            c.push_back(stack::getx<E>(L, 3));
+
+        else
+            luaL_error(L, "index %d out of range", static_cast<int>(i));
+    }
+};
+
+// keys of the wrong type are simply absent; assigning nil erases
+template<typename C>
+struct map_access
+{
+    using K = typename C::key_type;
+    using V = typename C::mapped_type;
+
+    static void index(lua_State* L, C& c)
+    {
+        if ( !stack::is<K>(L, 2) )
+        {
+            lua_pushnil(L);
+            return;
+        }
+
+        auto it = c.find(stack::cast<K>(L, 2));
+        if ( it == c.end() )
+            lua_pushnil(L);
+        else
+            push_element<V>(L, it->second);
+    }
+
+    static void newindex(lua_State* L, C& c)
+    {
+        auto k = stack::getx<K>(L, 2);
+
+        if ( lua_isnil(L, 3) )
+        {
+            c.erase(k);
+            return;
+        }
+
+        auto v = stack::getx<V>(L, 3);
+
+        auto it = c.find(k);
+        if ( it == c.end() )
+            c.emplace(std::move(k), std::move(v));
+        else
+            it->second = std::move(v);
+    }
+};
+
+template<typename C>
+struct container_access;
+
+template<typename T, typename A>
+struct container_access<std::vector<T, A>> :
+    sequence_access<std::vector<T, A>> {};
+
+template<typename T, typename A>
+struct container_access<std::deque<T, A>> :
+    sequence_access<std::deque<T, A>> {};
+
+template<typename K, typename V, typename H, typename E, typename A>
+struct container_access<std::unordered_map<K, V, H, E, A>> :
+    map_access<std::unordered_map<K, V, H, E, A>> {};
+
+// a userdata block holding a non-owning pointer to a container, with
+// __index, __newindex and __len working on the container itself
+template<typename C>
+struct container_proxy
+{
+    using access = container_access<C>;
+
+    // pushes a proxy for c. if owner is given, the value at that index is
+    // kept alive for as long as the proxy is, through its environment
+    // table; otherwise c has to outlive the proxy
+    static void push(lua_State* L, C& c, int owner = 0)
+    {
+        if ( owner )
+            owner = abs_index(lua_gettop(L), owner);
+
+        userdata<C>::push(L, c);
+        push_metatable(L);
+        lua_setmetatable(L, -2);
+
+        if ( owner )
+        {
+            lua_createtable(L, 1, 0);
+            lua_pushvalue(L, owner);
+            lua_rawseti(L, -2, 1);
+            lua_setfenv(L, -2);
+        }
+    }
+
+    // pushes the metatable shared by every proxy for C in this state,
+    // creating it on first use
+    static void push_metatable(lua_State* L)
+    {
+        lua_pushlightuserdata(L, meta_key());
+        lua_rawget(L, LUA_REGISTRYINDEX);
+
+        if ( lua_istable(L, -1) )
+            return;
+
+        lua_pop(L, 1);
+
+        lua_createtable(L, 0, 4);
+        auto meta = lua_gettop(L);
+
+        // each metamethod holds the metatable, to check what it's called on
+        lua_pushliteral(L, "__index");
+        lua_pushvalue(L, meta);
+        lua_pushcclosure(L, index, 1);
+        lua_rawset(L, meta);
+
+        lua_pushliteral(L, "__newindex");
+        lua_pushvalue(L, meta);
+        lua_pushcclosure(L, newindex, 1);
+        lua_rawset(L, meta);
+
+        lua_pushliteral(L, "__len");
+        lua_pushvalue(L, meta);
+        lua_pushcclosure(L, len, 1);
+        lua_rawset(L, meta);
+
+        // keeps scripts from calling the metamethods on anything else
+        lua_pushliteral(L, "__metatable");
+        lua_pushboolean(L, false);
+        lua_rawset(L, meta);
+
+        lua_pushlightuserdata(L, meta_key());
+        lua_pushvalue(L, meta);
+        lua_rawset(L, LUA_REGISTRYINDEX);
+    }
+
+private:
+    // the container behind the proxy at index 1; the metamethods can still
+    // be called on anything through debug.getmetatable
+    static C& container(lua_State* L)
+    {
+        if ( !lua_getmetatable(L, 1) or
+            !lua_rawequal(L, -1, lua_upvalueindex(1)) )
+            luaL_error(L, "expected a container proxy, got '%s'",
+                luaL_typename(L, 1));
+
+        lua_pop(L, 1);
+        return **userdata<C>::extract(L, 1);
+    }
+
+    static int index(lua_State* L)
+    {
+        return detail::protect(L, [L]
+        {
+            access::index(L, container(L));
+            return 1;
+        });
+    }
+
+    static int newindex(lua_State* L)
+    {
+        return detail::protect(L, [L]
+        {
+            access::newindex(L, container(L));
+            return 0;
+        });
+    }
+
+    static int len(lua_State* L)
+    {
+        lua_pushinteger(L, container(L).size());
+        return 1;
+    }
+
+    // the address identifies C's metatable in each state's registry
+    static void* meta_key()
+    {
+        static const char k = 0;
+        return const_cast<char*>(&k);
+    }
+};
+
+} // namespace util
+
+namespace detail
+{
+
+// a method returning a proxy for a container member of its object; the
+// member pointer lives in an upvalue
+template<typename T, typename C>
+struct member_proxy_pusher
+{
+    using Member = C T::*;
+
+    static int proxy(lua_State* L)
+    {
+        auto member = util::gc_object::cast<Member>(L, lua_upvalueindex(1));
+
+        return protect(L, [L, member]
+        {
+            auto& self = stack::getx<T&>(L, 1);
+            util::container_proxy<C>::push(L, self.*member, 1);
+            return 1;
+        });
+    }
+
+    static void push(lua_State* L, Member member)
+    {
+        util::gc_object::push(L, member);
+        lua_pushcclosure(L, proxy, 1);
+    }
+};
+
+} // namespace detail
+
+}
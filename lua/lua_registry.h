@@ -0,0 +1,261 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <luajit-2.0/lua.hpp>
+
+#include "shim_types.h"
+#include "lua_util.h"
+
+// per-state registry of bound types
+
+namespace Lua
+{
+
+namespace util
+{
+
+inline std::size_t next_type_id()
+{
+    static std::atomic<std::size_t> next { 0 };
+    return next++;
+}
+
+// dense process-wide id for T, assigned on first use and never changed
+template<typename T>
+struct type_id
+{
+    static std::size_t value()
+    {
+        static const std::size_t id = next_type_id();
+        return id;
+    }
+};
+
+// names built from the names of registered types, e.g. "table of Point",
+// are built once and kept in a table in the registry, which adding or
+// removing a type drops
+
+inline void* derived_names_key()
+{
+    static const char k = 0;
+    return const_cast<char*>(&k);
+}
+
+// pushes the table, creating it if needed
+inline void push_derived_names(lua_State* L)
+{
+    lua_pushlightuserdata(L, derived_names_key());
+    lua_rawget(L, LUA_REGISTRYINDEX);
+
+    if ( !lua_istable(L, -1) )
+    {
+        lua_pop(L, 1);
+        lua_newtable(L);
+
+        lua_pushlightuserdata(L, derived_names_key());
+        lua_pushvalue(L, -2);
+        lua_rawset(L, LUA_REGISTRYINDEX);
+    }
+}
+
+inline void drop_derived_names(lua_State* L)
+{
+    lua_pushlightuserdata(L, derived_names_key());
+    lua_pushnil(L);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+}
+
+struct TypeEntry
+{
+    std::string name;
+
+    // registry ref keeping the metatable alive, and its identity
+    int meta_ref = LUA_NOREF;
+    const void* meta = nullptr;
+
+    int method_count = 0;
+};
+
+// lives in a userdata block in the Lua registry, so every lua_State has its
+// own set of types and nothing is shared between states. entries are only
+// written while registering, which makes call-time lookups plain reads.
+class TypeRegistry
+{
+public:
+    // returns nullptr if nothing has been registered in this state
+    static TypeRegistry* get(lua_State* L)
+    {
+        lua_pushlightuserdata(L, key());
+        lua_rawget(L, LUA_REGISTRYINDEX);
+        auto r = static_cast<TypeRegistry*>(lua_touserdata(L, -1));
+        lua_pop(L, 1);
+        return r;
+    }
+
+    // returns the registry for this state, creating it if needed
+    static TypeRegistry& open(lua_State* L)
+    {
+        if ( auto r = get(L) )
+            return *r;
+
+        lua_pushlightuserdata(L, key());
+        auto r = new (lua_newuserdata(L, sizeof(TypeRegistry))) TypeRegistry;
+
+        lua_newtable(L);
+        lua_pushliteral(L, "__gc");
+        lua_pushcfunction(L, gc);
+        lua_rawset(L, -3);
+        lua_setmetatable(L, -2);
+
+        lua_rawset(L, LUA_REGISTRYINDEX);
+        return *r;
+    }
+
+    // registers T under name, with the metatable at index meta
+    template<typename T>
+    TypeEntry& add(lua_State* L, const char* name, int meta)
+    {
+        assert(name);
+        assert(lua_istable(L, meta));
+
+        auto id = type_id<typename base<T>::type>::value();
+        if ( id >= types.size() )
+            types.resize(id + 1);
+
+        auto& entry = types[id];
+        if ( !entry )
+            entry.reset(new TypeEntry);
+
+        else
+            luaL_unref(L, LUA_REGISTRYINDEX, entry->meta_ref);
+
+        entry->name = name;
+        entry->meta = lua_topointer(L, meta);
+
+        lua_pushvalue(L, meta);
+        entry->meta_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+        drop_derived_names(L);
+        return *entry;
+    }
+
+    template<typename T>
+    void remove(lua_State* L)
+    {
+        auto id = type_id<typename base<T>::type>::value();
+        if ( id < types.size() && types[id] )
+        {
+            luaL_unref(L, LUA_REGISTRYINDEX, types[id]->meta_ref);
+            types[id].reset();
+            drop_derived_names(L);
+        }
+    }
+
+    // entries never move once added
+    template<typename T>
+    TypeEntry* find() const
+    {
+        auto id = type_id<typename base<T>::type>::value();
+        return ( id < types.size() ) ? types[id].get() : nullptr;
+    }
+
+private:
+    static void* key()
+    {
+        static const char k = 0;
+        return const_cast<char*>(&k);
+    }
+
+    static int gc(lua_State* L)
+    {
+        static_cast<TypeRegistry*>(lua_touserdata(L, 1))->~TypeRegistry();
+
+        // later finalizers see an empty state
+        lua_pushlightuserdata(L, key());
+        lua_pushnil(L);
+        lua_rawset(L, LUA_REGISTRYINDEX);
+        return 0;
+    }
+
+    std::vector<std::unique_ptr<TypeEntry>> types;
+};
+
+template<typename T>
+inline TypeEntry* find_type(lua_State* L)
+{
+    auto r = TypeRegistry::get(L);
+    return r ? r->find<T>() : nullptr;
+}
+
+// names of bound functions, e.g. "Point:sum", for diagnostics. kept in a
+// weak-keyed table in the registry, so naming a function doesn't keep it
+// alive
+
+inline void* function_names_key()
+{
+    static const char k = 0;
+    return const_cast<char*>(&k);
+}
+
+inline void name_function(lua_State* L, int fn, const std::string& name)
+{
+    fn = abs_index(lua_gettop(L), fn);
+
+    lua_pushlightuserdata(L, function_names_key());
+    lua_rawget(L, LUA_REGISTRYINDEX);
+
+    if ( !lua_istable(L, -1) )
+    {
+        lua_pop(L, 1);
+        lua_newtable(L);
+
+        lua_createtable(L, 0, 1);
+        lua_pushliteral(L, "__mode");
+        lua_pushliteral(L, "k");
+        lua_rawset(L, -3);
+        lua_setmetatable(L, -2);
+
+        lua_pushlightuserdata(L, function_names_key());
+        lua_pushvalue(L, -2);
+        lua_rawset(L, LUA_REGISTRYINDEX);
+    }
+
+    lua_pushvalue(L, fn);
+    lua_pushlstring(L, name.c_str(), name.size());
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+}
+
+// pushes the name given to the function at fn, or returns false with
+// nothing pushed
+inline bool push_function_name(lua_State* L, int fn)
+{
+    fn = abs_index(lua_gettop(L), fn);
+
+    lua_pushlightuserdata(L, function_names_key());
+    lua_rawget(L, LUA_REGISTRYINDEX);
+
+    if ( lua_istable(L, -1) )
+    {
+        lua_pushvalue(L, fn);
+        lua_rawget(L, -2);
+        lua_remove(L, -2);
+
+        if ( lua_isstring(L, -1) )
+            return true;
+    }
+
+    lua_pop(L, 1);
+    return false;
+}
+
+} // namespace util
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+namespace Lua
+{
+
+// a view of contiguous elements, pushed as a Lua array without building a
+// container first; std::span works the same way under C++20
+template<typename T>
+class Span
+{
+public:
+    using value_type = typename std::remove_const<T>::type;
+
+    Span(T* ptr, std::size_t len) : ptr(ptr), len(len) { }
+
+    template<typename Container>
+    Span(Container& c) : ptr(c.data()), len(c.size()) { }
+
+    T* data() const
+    { return ptr; }
+
+    std::size_t size() const
+    { return len; }
+
+    T* begin() const
+    { return ptr; }
+
+    T* end() const
+    { return ptr + len; }
+
+private:
+    T* ptr;
+    std::size_t len;
+};
+
+}
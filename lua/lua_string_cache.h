@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#include <luajit-2.0/lua.hpp>
+
+// per-state cache of pinned Lua strings, for strings pushed over and over
+
+namespace Lua
+{
+
+namespace util
+{
+
+// the characters of a key, compared by content. they're never copied, so
+// keys are made from static storage only
+struct KeyChars
+{
+    const char* s;
+    std::size_t len;
+
+    bool operator==(const KeyChars& o) const
+    { return len == o.len and std::memcmp(s, o.s, len) == 0; }
+};
+
+// FNV-1a
+struct KeyCharsHash
+{
+    std::size_t operator()(const KeyChars& k) const
+    {
+        std::uint64_t h = 0xcbf29ce484222325ull;
+        for ( std::size_t i = 0; i < k.len; ++i )
+            h = (h ^ static_cast<unsigned char>(k.s[i])) * 0x100000001b3ull;
+
+        return static_cast<std::size_t>(h);
+    }
+};
+
+// equal strings share an id, so the ids, and the strings pinned for them
+// in each state, are bounded by the distinct keys in the program. only a
+// string's first key allocates, for its node in the table
+inline std::size_t key_id(const char* s, std::size_t len)
+{
+    static std::mutex lock;
+    static std::unordered_map<KeyChars, std::size_t, KeyCharsHash> ids;
+
+    KeyChars k { s, len };
+
+    // emplace would make a node before finding the string
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = ids.find(k);
+    if ( it != ids.end() )
+        return it->second;
+
+    return ids.emplace(k, ids.size()).first->second;
+}
+
+} // namespace util
+
+// a constant string with a dense process-wide id, e.g.
+//     static const Lua::Key name("name");
+// keys must be static, and are made from string literals only: a key made
+// from each string seen at runtime would pin every one of them, and the id
+// table refers to the characters of the first key of each string. making
+// a key takes a process-wide lock to look its id up, so make each once and
+// keep it rather than making it on a hot path
+class Key
+{
+public:
+    template<std::size_t N>
+    Key(const char (&s)[N]) :
+        str(s), len(N - 1), id(util::key_id(s, N - 1)) { }
+
+    // a mutable buffer may hold something else by the next push
+    template<std::size_t N>
+    Key(char (&)[N]) = delete;
+
+    const char* data() const
+    { return str; }
+
+    std::size_t size() const
+    { return len; }
+
+    std::size_t index() const
+    { return id; }
+
+private:
+    const char* str;
+    std::size_t len;
+    std::size_t id;
+};
+
+// lives in a userdata block in the Lua registry, like TypeRegistry. each
+// key's string is interned once per state and pinned with a registry ref,
+// so pushing it is a single lua_rawgeti instead of hashing and looking up
+// the characters again. look the cache up once and hold on to it; the
+// stack::push overload for keys has to find it on every call.
+class StringCache
+{
+public:
+    // returns the cache for this state, creating it if needed
+    static StringCache& open(lua_State* L)
+    {
+        lua_pushlightuserdata(L, key());
+        lua_rawget(L, LUA_REGISTRYINDEX);
+        auto c = static_cast<StringCache*>(lua_touserdata(L, -1));
+        lua_pop(L, 1);
+
+        if ( c )
+            return *c;
+
+        lua_pushlightuserdata(L, key());
+        c = new (lua_newuserdata(L, sizeof(StringCache))) StringCache;
+
+        lua_newtable(L);
+        lua_pushliteral(L, "__gc");
+        lua_pushcfunction(L, gc);
+        lua_rawset(L, -3);
+        lua_setmetatable(L, -2);
+
+        lua_rawset(L, LUA_REGISTRYINDEX);
+        return *c;
+    }
+
+    void push(lua_State* L, const Key& k)
+    {
+        auto i = k.index();
+        if ( i < refs.size() and refs[i] != LUA_NOREF )
+        {
+            lua_rawgeti(L, LUA_REGISTRYINDEX, refs[i]);
+            return;
+        }
+
+        pin(L, k);
+    }
+
+    // number of strings pinned in this state
+    std::size_t size() const
+    { return pinned; }
+
+private:
+    void pin(lua_State* L, const Key& k)
+    {
+        auto i = k.index();
+        if ( i >= refs.size() )
+            refs.resize(i + 1, LUA_NOREF);
+
+        lua_pushlstring(L, k.data(), k.size());
+        lua_pushvalue(L, -1);
+        refs[i] = luaL_ref(L, LUA_REGISTRYINDEX);
+        ++pinned;
+    }
+
+    static void* key()
+    {
+        static const char k = 0;
+        return const_cast<char*>(&k);
+    }
+
+    // the pinned strings go with the registry when the state closes
+    static int gc(lua_State* L)
+    {
+        static_cast<StringCache*>(lua_touserdata(L, 1))->~StringCache();
+
+        lua_pushlightuserdata(L, key());
+        lua_pushnil(L);
+        lua_rawset(L, LUA_REGISTRYINDEX);
+        return 0;
+    }
+
+    std::vector<int> refs;
+    std::size_t pinned = 0;
+};
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace Lua
+{
+
+// borrows the bytes of a Lua string without copying them. as an argument
+// it stays valid for the duration of the call, since the string is held
+// by the Lua stack; std::string_view works the same way under C++17
+class StringSpan
+{
+public:
+    StringSpan() : ptr(nullptr), len(0) { }
+    StringSpan(const char* ptr, std::size_t len) : ptr(ptr), len(len) { }
+
+    StringSpan(const std::string& s) : ptr(s.data()), len(s.size()) { }
+
+    const char* data() const
+    { return ptr; }
+
+    std::size_t size() const
+    { return len; }
+
+    std::string str() const
+    { return std::string(ptr, len); }
+
+private:
+    const char* ptr;
+    std::size_t len;
+};
+
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <luajit-2.0/lua.hpp>
+
+#include "lua_registry.h"
+
+// JIT trace abort diagnostics: which bindings keep hot loops from being
+// compiled, named the way they were registered
+
+namespace Lua
+{
+
+struct TraceAbort
+{
+    // e.g. "Point:sum", or empty if the abort didn't involve a named
+    // binding
+    std::string binding;
+
+    // e.g. "NYI: C function Point:sum"
+    std::string reason;
+
+    // where in the Lua source the trace was aborted
+    std::string location;
+
+    std::size_t count;
+};
+
+// records the aborts reported through jit.attach. the reasons come from
+// jit.vmdef when it is installed, and are only the error codes otherwise.
+// detach, or destroy the object, before closing the state
+class TraceDiagnostics
+{
+public:
+    TraceDiagnostics() = default;
+
+    TraceDiagnostics(const TraceDiagnostics&) = delete;
+    TraceDiagnostics& operator=(const TraceDiagnostics&) = delete;
+
+    ~TraceDiagnostics()
+    { detach(); }
+
+    // returns false if the state has no JIT
+    bool attach(lua_State* L_)
+    {
+        detach();
+
+        lua_getglobal(L_, "jit");
+        if ( !lua_istable(L_, -1) )
+        {
+            lua_pop(L_, 1);
+            return false;
+        }
+
+        auto jit = lua_gettop(L_);
+
+        lua_getfield(L_, jit, "util");
+        if ( lua_istable(L_, -1) )
+        {
+            lua_getfield(L_, -1, "funcinfo");
+            funcinfo_ref = luaL_ref(L_, LUA_REGISTRYINDEX);
+        }
+        lua_pop(L_, 1);
+
+        traceerr_ref = load_traceerr(L_);
+
+        lua_getfield(L_, jit, "attach");
+        lua_pushlightuserdata(L_, this);
+        lua_pushcclosure(L_, handler, 1);
+        lua_pushvalue(L_, -1);
+        handler_ref = luaL_ref(L_, LUA_REGISTRYINDEX);
+        lua_pushliteral(L_, "trace");
+        lua_call(L_, 2, 0);
+
+        lua_pop(L_, 1);
+
+        L = L_;
+        return true;
+    }
+
+    void detach()
+    {
+        if ( !L )
+            return;
+
+        lua_getglobal(L, "jit");
+        lua_getfield(L, -1, "attach");
+        lua_rawgeti(L, LUA_REGISTRYINDEX, handler_ref);
+        lua_call(L, 1, 0);
+        lua_pop(L, 1);
+
+        luaL_unref(L, LUA_REGISTRYINDEX, handler_ref);
+        luaL_unref(L, LUA_REGISTRYINDEX, funcinfo_ref);
+        luaL_unref(L, LUA_REGISTRYINDEX, traceerr_ref);
+
+        handler_ref = funcinfo_ref = traceerr_ref = LUA_NOREF;
+        L = nullptr;
+    }
+
+    void clear()
+    { aborts.clear(); }
+
+    // most frequent first
+    std::vector<TraceAbort> ranked() const
+    {
+        std::vector<TraceAbort> r;
+        for ( const auto& a : aborts )
+        {
+            r.push_back({ std::get<0>(a.first), std::get<1>(a.first),
+                std::get<2>(a.first), a.second });
+        }
+
+        std::stable_sort(r.begin(), r.end(),
+            [](const TraceAbort& a, const TraceAbort& b)
+            { return a.count > b.count; });
+
+        return r;
+    }
+
+    // one line per abort, most frequent first
+    void report(FILE* out) const
+    {
+        std::fprintf(out, "%8s  %-24s  %s\n", "aborts", "binding", "reason");
+        for ( const auto& a : ranked() )
+        {
+            std::fprintf(out, "%8zu  %-24s  %s at %s\n", a.count,
+                a.binding.empty() ? "-" : a.binding.c_str(),
+                a.reason.c_str(), a.location.c_str());
+        }
+    }
+
+private:
+    // pcall(require, "jit.vmdef").traceerr, if there is one
+    static int load_traceerr(lua_State* L)
+    {
+        lua_getglobal(L, "require");
+        lua_pushliteral(L, "jit.vmdef");
+        if ( lua_pcall(L, 1, 1, 0) or !lua_istable(L, -1) )
+        {
+            lua_pop(L, 1);
+            return LUA_NOREF;
+        }
+
+        lua_getfield(L, -1, "traceerr");
+        lua_remove(L, -2);
+        return luaL_ref(L, LUA_REGISTRYINDEX);
+    }
+
+    // called as handler(what, tr, func, pc, code, info)
+    static int handler(lua_State* L)
+    {
+        auto self = static_cast<TraceDiagnostics*>(
+            lua_touserdata(L, lua_upvalueindex(1)));
+
+        auto what = lua_tostring(L, 1);
+        if ( what and !std::strcmp(what, "abort") )
+            self->record(L);
+
+        return 0;
+    }
+
+    void record(lua_State* L)
+    {
+        std::string binding;
+        std::string info;
+
+        if ( lua_isfunction(L, 6) and util::push_function_name(L, 6) )
+        {
+            binding = lua_tostring(L, -1);
+            info = binding;
+            lua_pop(L, 1);
+        }
+
+        else if ( lua_isfunction(L, 6) )
+        {
+            info = lua_pushfstring(L, "%s: %p", luaL_typename(L, 6),
+                lua_topointer(L, 6));
+            lua_pop(L, 1);
+        }
+
+        else if ( lua_isstring(L, 6) )
+            info = lua_tostring(L, 6);
+
+        auto key = std::make_tuple(binding, reason(L, info), location(L));
+        ++aborts[key];
+    }
+
+    std::string reason(lua_State* L, const std::string& info)
+    {
+        auto code = static_cast<int>(lua_tointeger(L, 5));
+
+        std::string fmt;
+        if ( traceerr_ref != LUA_NOREF )
+        {
+            lua_rawgeti(L, LUA_REGISTRYINDEX, traceerr_ref);
+            lua_rawgeti(L, -1, code);
+            if ( lua_isstring(L, -1) )
+                fmt = lua_tostring(L, -1);
+            lua_pop(L, 2);
+        }
+
+        if ( fmt.empty() )
+            return "trace error " + std::to_string(code) +
+                ( info.empty() ? "" : " (" + info + ")" );
+
+        // the formats take at most one %s or %d
+        auto i = fmt.find('%');
+        if ( i != std::string::npos and i + 1 < fmt.size() )
+            fmt.replace(i, 2, info);
+
+        return fmt;
+    }
+
+    // jit.util.funcinfo(func, pc).loc
+    std::string location(lua_State* L)
+    {
+        if ( funcinfo_ref == LUA_NOREF )
+            return "?";
+
+        lua_rawgeti(L, LUA_REGISTRYINDEX, funcinfo_ref);
+        lua_pushvalue(L, 3);
+        lua_pushvalue(L, 4);
+        lua_call(L, 2, 1);
+
+        std::string loc = "?";
+        if ( lua_istable(L, -1) )
+        {
+            lua_getfield(L, -1, "loc");
+            if ( lua_isstring(L, -1) )
+                loc = lua_tostring(L, -1);
+            lua_pop(L, 1);
+        }
+
+        lua_pop(L, 1);
+        return loc;
+    }
+
+    lua_State* L = nullptr;
+    int handler_ref = LUA_NOREF;
+    int funcinfo_ref = LUA_NOREF;
+    int traceerr_ref = LUA_NOREF;
+
+    std::map<std::tuple<std::string, std::string, std::string>, std::size_t>
+        aborts;
+};
+
+}
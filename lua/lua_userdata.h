@@ -1,37 +1,42 @@
 #pragma once
 
 #include <cassert>
+#include <cstdint>
+#include <new>
+#include <utility>
 
 #include "shim_types.h"
 #include "shim_defs.h"
 #include "lua_util.h"
+#include "lua_registry.h"
 
 // helpers for working with Lua userdata
 
 namespace Lua
 {
 
-namespace traits
-{
-
-template<typename T>
-struct type_name_storage
-{ static std::string value; };
-
-template<typename T>
-std::string type_name_storage<T>::value = "";
-
-} // namespace traits
-
-
 namespace util
 {
 
+// userdata blocks always start with a pointer to the object. objects created
+// by emplace() live inline in the same block, directly after the pointer, so
+// they cost a single Lua allocation and are owned (and destroyed) by the
+// userdata. blocks created by push() only hold a non-owning pointer.
 template<typename T>
 struct userdata
 {
     using base_type = typename util::base<T>::type;
 
+    static constexpr size_t header_size = sizeof(base_type*);
+
+    // lua_newuserdata only guarantees pointer alignment
+    static constexpr size_t padding =
+        ( alignof(base_type) > alignof(base_type*) ) ?
+            alignof(base_type) - alignof(base_type*) : 0;
+
+    static constexpr size_t inline_size =
+        header_size + padding + sizeof(base_type);
+
     static base_type** extract(lua_State* L, int n)
     {
         auto h = static_cast<base_type**>(lua_touserdata(L, n));
@@ -41,17 +46,35 @@ struct userdata
 
     static base_type** allocate(lua_State* L)
     {
-        auto h = static_cast<base_type**>(lua_newuserdata(L, sizeof(base_type*)));
+        auto h = static_cast<base_type**>(lua_newuserdata(L, header_size));
+        assert(h);
+        return h;
+    }
+
+    // address of the inline object storage for a block of inline_size
+    static void* storage(base_type** h)
+    {
+        auto p = reinterpret_cast<std::uintptr_t>(h + 1);
+        const auto align = alignof(base_type);
+        return reinterpret_cast<void*>((p + align - 1) & ~(align - 1));
+    }
+
+    // allocates a block with room for an inline base_type; the pointer is
+    // left as nullptr until the object has been constructed in storage()
+    static base_type** allocate_inline(lua_State* L)
+    {
+        auto h = static_cast<base_type**>(lua_newuserdata(L, inline_size));
         assert(h);
+        *h = nullptr;
         return h;
     }
 
+    // constructs a base_type in place inside a new userdata block
     template<typename... Args>
     static base_type* emplace(lua_State* L, Args&&... args)
     {
-        auto h = allocate(L);
-        *h = new base_type(std::forward<Args>(args)...);
-        assert(*h);
+        auto h = allocate_inline(L);
+        *h = new (storage(h)) base_type(std::forward<Args>(args)...);
         return *h;
     }
 
@@ -61,28 +84,41 @@ struct userdata
         *h = &o;
     }
 
+    static bool is_inline(lua_State* L, int n)
+    { return lua_objlen(L, n) >= inline_size; }
+
+    // pushes the registered metatable, or nil if base_type is not registered
+    static void push_metatable(lua_State* L)
+    {
+        auto entry = find_type<base_type>(L);
+        if ( entry )
+            lua_rawgeti(L, LUA_REGISTRYINDEX, entry->meta_ref);
+        else
+            lua_pushnil(L);
+    }
+
     static void assign_metatable(lua_State* L, int n)
     {
         assert(lua_type(L, n) == LUA_TUSERDATA);
 
-        const auto& name = traits::type_name_storage<base_type>::value;
-        assert(!name.empty());
-
         auto idx = util::abs_index(lua_gettop(L), n);
 
-        luaL_getmetatable(L, name.c_str());
+        push_metatable(L);
         assert(lua_type(L, -1) == LUA_TTABLE);
 
         lua_setmetatable(L, idx);
     }
 
-    // deletes a userdata and sets its pointer to nullptr
+    // destroys an inline object (non-owning pointers are only released) and
+    // sets the userdata pointer to nullptr
     static void destroy(lua_State* L, int n)
     {
         auto h = extract(L, n);
         if ( *h )
         {
-            delete *h;
+            if ( is_inline(L, n) )
+                (*h)->~base_type();
+
             *h = nullptr;
         }
     }
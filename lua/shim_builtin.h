@@ -35,6 +35,14 @@ template<typename T>
 struct trait<T, enable_for<is_c_str<T>()>>
 { using tag = tags::c_string; };
 
+template<typename T>
+struct trait<T, enable_for<is_str_view<T>()>>
+{ using tag = tags::string_view; };
+
+template<typename T>
+struct trait<T, enable_for<is_key<T>()>>
+{ using tag = tags::key; };
+
 template<typename T>
 struct lua_type_code<T, enable_for<is_num<T>()>>
 { static constexpr auto value = LUA_TNUMBER; };
@@ -58,14 +66,19 @@ template<typename T>
 inline bool is(tags::builtin, lua_State* L, int n)
 { return lua_type(L, n) == traits::lua_type_code<T>::value; }
 
+// try_get is the fused check and conversion behind stack::getx; it
+// leaves v untouched and returns false if n doesn't hold a T. LuaJIT 2.0
+// has no lua_tonumberx, and lua_tonumber/lua_tolstring silently coerce
+// strings and numbers, so the lua_type probe stays as the guard.
+
 // integral types
 
 template<typename T>
-inline std::string type_name(tags::integral)
+inline const char* type_name(tags::integral, lua_State*)
 { return "integer"; }
 
 template<typename T>
-inline std::string type_name(tags::unsigned_integral)
+inline const char* type_name(tags::unsigned_integral, lua_State*)
 { return "unsigned"; }
 
 // special type-checking overload for unsigned
@@ -86,10 +99,35 @@ template<typename T>
 inline T cast(tags::integral, lua_State* L, int n)
 { return lua_tointeger(L, n); }
 
+template<typename T>
+inline bool try_get(tags::integral, lua_State* L, int n, T& v)
+{
+    if ( lua_type(L, n) != LUA_TNUMBER )
+        return false;
+
+    v = lua_tointeger(L, n);
+    return true;
+}
+
+// reads the value once for both the range check and the result
+template<typename T>
+inline bool try_get(tags::unsigned_integral, lua_State* L, int n, T& v)
+{
+    if ( lua_type(L, n) != LUA_TNUMBER )
+        return false;
+
+    auto i = lua_tointeger(L, n);
+    if ( i <= 0 )
+        return false;
+
+    v = i;
+    return true;
+}
+
 // floating point types
 
 template<typename T>
-inline std::string type_name(tags::floating_point)
+inline const char* type_name(tags::floating_point, lua_State*)
 { return "number"; }
 
 template<typename T>
@@ -100,10 +138,20 @@ template<typename T>
 inline T cast(tags::floating_point, lua_State* L, int n)
 { return lua_tonumber(L, n); }
 
+template<typename T>
+inline bool try_get(tags::floating_point, lua_State* L, int n, T& v)
+{
+    if ( lua_type(L, n) != LUA_TNUMBER )
+        return false;
+
+    v = lua_tonumber(L, n);
+    return true;
+}
+
 // boolean types
 
 template<typename T>
-inline std::string type_name(tags::boolean)
+inline const char* type_name(tags::boolean, lua_State*)
 { return "boolean"; }
 
 template<typename T>
@@ -114,31 +162,95 @@ template<typename T>
 inline T cast(tags::boolean, lua_State* L, int n)
 { return lua_toboolean(L, n); }
 
+template<typename T>
+inline bool try_get(tags::boolean, lua_State* L, int n, T& v)
+{
+    if ( lua_type(L, n) != LUA_TBOOLEAN )
+        return false;
+
+    v = lua_toboolean(L, n);
+    return true;
+}
+
 // string types
 
 template<typename T>
-inline std::string type_name(tags::string)
+inline const char* type_name(tags::string, lua_State*)
 { return "string"; }
 
 template<typename T>
-inline void push(tags::std_string, lua_State* L, T val)
+inline void push(tags::std_string, lua_State* L, const T& val)
 { lua_pushlstring(L, val.c_str(), val.size()); }
 
 template<typename T>
 inline void push(tags::c_string, lua_State* L, T val)
 { lua_pushstring(L, val); }
 
+template<typename T>
+inline void push(tags::string_view, lua_State* L, const T& val)
+{ lua_pushlstring(L, val.data(), val.size()); }
+
+// finds the cache on every push; hold a StringCache& on hot paths
+template<typename T>
+inline void push(tags::key, lua_State* L, const T& val)
+{ StringCache::open(L).push(L, val); }
+
 template<typename T>
 inline T cast(tags::std_string, lua_State* L, int n)
 {
     size_t len;
-    return T(lua_tolstring(L, n, &len), len);
+    auto s = lua_tolstring(L, n, &len);
+    return T(s, len);
 }
 
 template<typename T>
 inline T cast(tags::c_string, lua_State* L, int n)
 { return lua_tostring(L, n); }
 
+// points into the interned Lua string
+template<typename T>
+inline T cast(tags::string_view, lua_State* L, int n)
+{
+    size_t len;
+    auto s = lua_tolstring(L, n, &len);
+    return T(s, len);
+}
+
+// lua_tolstring would convert a number argument in place
+template<typename T>
+inline bool try_get(tags::std_string, lua_State* L, int n, T& v)
+{
+    if ( lua_type(L, n) != LUA_TSTRING )
+        return false;
+
+    size_t len;
+    auto s = lua_tolstring(L, n, &len);
+    v.assign(s, len);
+    return true;
+}
+
+template<typename T>
+inline bool try_get(tags::c_string, lua_State* L, int n, T& v)
+{
+    if ( lua_type(L, n) != LUA_TSTRING )
+        return false;
+
+    v = lua_tostring(L, n);
+    return true;
+}
+
+template<typename T>
+inline bool try_get(tags::string_view, lua_State* L, int n, T& v)
+{
+    if ( lua_type(L, n) != LUA_TSTRING )
+        return false;
+
+    size_t len;
+    auto s = lua_tolstring(L, n, &len);
+    v = T(s, len);
+    return true;
+}
+
 } // namespace impl
 
 }
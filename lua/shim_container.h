@@ -0,0 +1,406 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "lua_util.h"
+#include "shim_defs.h"
+#include "shim_types.h"
+#include "shim_builtin.h"
+#include "shim_enum.h"
+#include "shim_user.h"
+
+// std::vector, std::array and spans, marshaled to and from Lua arrays, and
+// std::map and std::unordered_map, marshaled to and from Lua tables
+
+namespace Lua
+{
+
+namespace traits
+{
+
+using namespace util;
+
+template<typename T>
+struct trait<T, enable_for<is_vector<T>()>>
+{ using tag = tags::vector; };
+
+template<typename T>
+struct trait<T, enable_for<is_std_array<T>()>>
+{ using tag = tags::array; };
+
+// push only: there is no storage for a span to point into
+template<typename T>
+struct trait<T, enable_for<is_span<T>()>>
+{ using tag = tags::span; };
+
+template<typename T>
+struct trait<T, enable_for<is_map<T>()>>
+{ using tag = tags::map; };
+
+template<typename T>
+struct trait<T, enable_for<is_unordered_map<T>()>>
+{ using tag = tags::unordered_map; };
+
+template<typename T>
+struct lua_type_code<T, enable_for<is_container<T>()>>
+{ static constexpr auto value = LUA_TTABLE; };
+
+} // namespace traits
+
+namespace impl
+{
+
+template<typename T>
+using tag_of = typename traits::trait<typename std::remove_const<T>::type>::tag;
+
+template<typename T>
+using element_tag = tag_of<typename T::value_type>;
+
+// elements are read back by value, so user types stay push only
+template<typename E>
+constexpr bool readable()
+{
+    return util::is_builtin<E>() or util::is_enum<E>() or
+        util::is_container<E>();
+}
+
+// the names of containers are built from the names their element types
+// have in this state, so each is built on the first error that needs it
+// and kept under key with the state's other derived names
+template<typename Build>
+inline const char* container_type_name(lua_State* L, void* key, Build build)
+{
+    util::push_derived_names(L);
+
+    lua_pushlightuserdata(L, key);
+    lua_rawget(L, -2);
+
+    auto s = lua_tostring(L, -1);
+    lua_pop(L, 1);
+
+    if ( !s )
+    {
+        auto name = build();
+
+        lua_pushlightuserdata(L, key);
+        lua_pushlstring(L, name.c_str(), name.size());
+        s = lua_tostring(L, -1);
+        lua_rawset(L, -3);
+    }
+
+    lua_pop(L, 1);
+    return s;
+}
+
+// each level of a nested container holds its table, and a key and a
+// value, on the stack while the level below is converted, plus a slot for
+// a user object's metatable, so every level reserves that much for itself
+constexpr int level_slots = 4;
+
+inline void reserve_level(lua_State* L)
+{ luaL_checkstack(L, level_slots, "container nested too deeply"); }
+
+// the address identifies T's name in each state's registry
+template<typename T>
+inline void* type_name_key()
+{
+    static const char k = 0;
+    return const_cast<char*>(&k);
+}
+
+// declared up front so nested containers find each other
+
+template<typename T>
+inline T cast(tags::vector, lua_State* L, int n);
+
+template<typename T>
+inline T cast(tags::array, lua_State* L, int n);
+
+template<typename T>
+inline bool try_get(tags::vector, lua_State* L, int n, T& v);
+
+template<typename T>
+inline bool try_get(tags::array, lua_State* L, int n, T& v);
+
+template<typename T>
+inline const char* type_name(tags::associative, lua_State* L);
+
+template<typename T>
+inline void push(tags::associative, lua_State* L, const T& val);
+
+template<typename T>
+inline T cast(tags::associative, lua_State* L, int n);
+
+template<typename T>
+inline bool try_get(tags::map, lua_State* L, int n, T& v);
+
+template<typename T>
+inline bool try_get(tags::unordered_map, lua_State* L, int n, T& v);
+
+// only the outer table is checked; getx checks every element
+template<typename T>
+inline bool is(tags::sequence, lua_State* L, int n)
+{ return lua_istable(L, n); }
+
+// e.g. "table of number"
+template<typename T>
+inline const char* type_name(tags::sequence, lua_State* L)
+{
+    using E = typename std::remove_const<typename T::value_type>::type;
+
+    return container_type_name(L, type_name_key<T>(), [L]
+    { return std::string("table of ") + type_name<E>(element_tag<T>(), L); });
+}
+
+template<typename T>
+inline void push(tags::sequence, lua_State* L, const T& val)
+{
+    using E = typename std::remove_const<typename T::value_type>::type;
+
+    reserve_level(L);
+    lua_createtable(L, static_cast<int>(val.size()), 0);
+    auto t = lua_gettop(L);
+
+    int i = 0;
+    for ( const auto& e : val )
+    {
+        push<E>(element_tag<T>(), L, e);
+        lua_rawseti(L, t, ++i);
+    }
+}
+
+template<typename T>
+inline T cast(tags::vector, lua_State* L, int n)
+{
+    using E = typename T::value_type;
+
+    n = util::abs_index(lua_gettop(L), n);
+    auto len = lua_objlen(L, n);
+    reserve_level(L);
+
+    T v;
+    v.reserve(len);
+
+    for ( std::size_t i = 1; i <= len; ++i )
+    {
+        lua_rawgeti(L, n, i);
+        v.push_back(cast<E>(element_tag<T>(), L, -1));
+        lua_pop(L, 1);
+    }
+
+    return v;
+}
+
+template<typename T>
+inline T cast(tags::array, lua_State* L, int n)
+{
+    using E = typename T::value_type;
+
+    n = util::abs_index(lua_gettop(L), n);
+    reserve_level(L);
+
+    T v;
+    for ( std::size_t i = 0; i < v.size(); ++i )
+    {
+        lua_rawgeti(L, n, i + 1);
+        v[i] = cast<E>(element_tag<T>(), L, -1);
+        lua_pop(L, 1);
+    }
+
+    return v;
+}
+
+// the length is taken with lua_objlen, so a table with holes is read up
+// to its border. unlike the builtins, v may be partly filled on failure
+template<typename T>
+inline bool try_get(tags::vector, lua_State* L, int n, T& v)
+{
+    static_assert(readable<typename T::value_type>(),
+        "only vectors of builtins, enums and containers can be read");
+
+    using E = typename T::value_type;
+
+    if ( !lua_istable(L, n) )
+        return false;
+
+    n = util::abs_index(lua_gettop(L), n);
+    auto len = lua_objlen(L, n);
+    reserve_level(L);
+    v.reserve(len);
+
+    for ( std::size_t i = 1; i <= len; ++i )
+    {
+        lua_rawgeti(L, n, i);
+
+        E e;
+        auto ok = try_get<E>(element_tag<T>(), L, -1, e);
+        lua_pop(L, 1);
+
+        if ( !ok )
+            return false;
+
+        v.push_back(std::move(e));
+    }
+
+    return true;
+}
+
+// the table must have exactly N elements
+template<typename T>
+inline bool try_get(tags::array, lua_State* L, int n, T& v)
+{
+    static_assert(readable<typename T::value_type>(),
+        "only arrays of builtins, enums and containers can be read");
+
+    using E = typename T::value_type;
+
+    if ( !lua_istable(L, n) )
+        return false;
+
+    n = util::abs_index(lua_gettop(L), n);
+    if ( lua_objlen(L, n) != v.size() )
+        return false;
+
+    reserve_level(L);
+
+    for ( std::size_t i = 0; i < v.size(); ++i )
+    {
+        lua_rawgeti(L, n, i + 1);
+        auto ok = try_get<E>(element_tag<T>(), L, -1, v[i]);
+        lua_pop(L, 1);
+
+        if ( !ok )
+            return false;
+    }
+
+    return true;
+}
+
+// associative containers
+
+template<typename T>
+inline bool is(tags::associative, lua_State* L, int n)
+{ return lua_istable(L, n); }
+
+// e.g. "table of string to number"
+template<typename T>
+inline const char* type_name(tags::associative, lua_State* L)
+{
+    using K = typename T::key_type;
+    using V = typename T::mapped_type;
+
+    return container_type_name(L, type_name_key<T>(), [L]
+    {
+        return std::string("table of ") + type_name<K>(tag_of<K>(), L) +
+            " to " + type_name<V>(tag_of<V>(), L);
+    });
+}
+
+// the hash part is sized once up front instead of growing with rehashes
+template<typename T>
+inline void push(tags::associative, lua_State* L, const T& val)
+{
+    using K = typename T::key_type;
+    using V = typename T::mapped_type;
+
+    reserve_level(L);
+    lua_createtable(L, 0, static_cast<int>(val.size()));
+    auto t = lua_gettop(L);
+
+    for ( const auto& kv : val )
+    {
+        push<K>(tag_of<K>(), L, kv.first);
+        push<V>(tag_of<V>(), L, kv.second);
+        lua_rawset(L, t);
+    }
+}
+
+template<typename T>
+inline T cast(tags::associative, lua_State* L, int n)
+{
+    using K = typename T::key_type;
+    using V = typename T::mapped_type;
+
+    n = util::abs_index(lua_gettop(L), n);
+    reserve_level(L);
+
+    T v;
+    lua_pushnil(L);
+    while ( lua_next(L, n) )
+    {
+        v.emplace(cast<K>(tag_of<K>(), L, -2), cast<V>(tag_of<V>(), L, -1));
+        lua_pop(L, 1);
+    }
+
+    return v;
+}
+
+// walks the table at absolute index n with lua_next. the keys are never
+// converted in place, which would confuse lua_next, since try_get checks
+// the lua_type first
+template<typename T>
+inline bool read_pairs(lua_State* L, int n, T& v)
+{
+    using K = typename T::key_type;
+    using V = typename T::mapped_type;
+
+    static_assert(readable<K>() and readable<V>(),
+        "only maps of builtins, enums and containers can be read");
+
+    reserve_level(L);
+    lua_pushnil(L);
+    while ( lua_next(L, n) )
+    {
+        K key;
+        V val;
+
+        if ( !try_get<K>(tag_of<K>(), L, -2, key) or
+            !try_get<V>(tag_of<V>(), L, -1, val) )
+        {
+            lua_pop(L, 2);
+            return false;
+        }
+
+        v.emplace(std::move(key), std::move(val));
+        lua_pop(L, 1);
+    }
+
+    return true;
+}
+
+template<typename T>
+inline bool try_get(tags::map, lua_State* L, int n, T& v)
+{
+    if ( !lua_istable(L, n) )
+        return false;
+
+    return read_pairs(L, util::abs_index(lua_gettop(L), n), v);
+}
+
+// Lua keeps no count of the hash part, so the entries are counted in a
+// first lua_next pass and reserved before any of them are inserted
+template<typename T>
+inline bool try_get(tags::unordered_map, lua_State* L, int n, T& v)
+{
+    if ( !lua_istable(L, n) )
+        return false;
+
+    n = util::abs_index(lua_gettop(L), n);
+    reserve_level(L);
+
+    std::size_t count = 0;
+    lua_pushnil(L);
+    while ( lua_next(L, n) )
+    {
+        ++count;
+        lua_pop(L, 1);
+    }
+
+    v.reserve(count);
+    return read_pairs(L, n, v);
+}
+
+} // namespace impl
+
+}
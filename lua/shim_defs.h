@@ -28,6 +28,8 @@ struct floating_point : numeric {};
 struct string : builtin {};
 struct std_string : string {};
 struct c_string : string {};
+struct string_view : string {};
+struct key : string {};
 struct boolean : builtin {};
 
 struct user {};
@@ -35,6 +37,15 @@ struct user_ptr : user {};
 
 struct enumeration {};
 
+struct sequence {};
+struct vector : sequence {};
+struct array : sequence {};
+struct span : sequence {};
+
+struct associative {};
+struct map : associative {};
+struct unordered_map : associative {};
+
 } // namespace tags
 
 }
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <cstdlib>
+#include <type_traits>
+#include <utility>
+
 #include "lua_util.h"
 #include "lua_exception.h"
 #include "shim_builtin.h"
 #include "shim_user.h"
 #include "shim_enum.h"
+#include "shim_container.h"
 
 namespace Lua
 {
@@ -13,8 +18,12 @@ namespace stack
 {
 
 template<typename T>
-inline void push(lua_State* L, T val)
-{ impl::push(typename traits::trait<T>::tag(), L, val); }
+inline void push(lua_State* L, T&& val)
+{
+    using type = typename std::decay<T>::type;
+    impl::push<type>(typename traits::trait<type>::tag(), L,
+        std::forward<T>(val));
+}
 
 template<typename T>
 inline T cast(lua_State* L, int n)
@@ -25,27 +34,86 @@ inline bool is(lua_State* L, int n)
 { return impl::is<T>(typename traits::trait<T>::tag(), L, n); }
 
 template<typename T>
-inline std::string type_name()
-{ return impl::type_name<T>(typename traits::trait<T>::tag()); }
+inline const char* type_name(lua_State* L)
+{ return impl::type_name<T>(typename traits::trait<T>::tag(), L); }
+
+// raised as a Lua error on the spot in the LUA_SHIM_LUAJIT_UNWIND and
+// LUA_SHIM_NO_EXCEPTIONS modes; arguments converted before the failing
+// one are only destroyed if LuaJIT unwinds the C++ frames. kept out of
+// line so the proxies' fast paths stay small
+template<typename T>
+[[noreturn]] __attribute__((noinline))
+inline void type_error(lua_State* L, int n)
+{
+    TypeError e(
+        util::abs_index(lua_gettop(L), n),
+        type_name<T>(L),
+        lua_typename(L, lua_type(L, n))
+    );
+
+#ifdef LUA_SHIM_RAISE_TYPE_ERRORS
+    e.raise(L);
+
+    // because the compiler doesn't know that lua_error does a long jump
+    std::abort();
+#else
+    throw e;
+#endif
+}
 
 template<typename T>
 inline void check(lua_State* L, int n)
 {
     if ( !is<T>(L, n) )
-        throw TypeError(
-            util::abs_index(lua_gettop(L), n),
-            type_name<T>(),
-            lua_typename(L, lua_type(L, n))
-        );
+        type_error<T>(L, n);
+}
+
+} // namespace stack
+
+namespace impl
+{
+
+// builtins and enums
+template<typename T, typename Tag>
+inline T getx(Tag tag, lua_State* L, int n)
+{
+    T v;
+    if ( !try_get<T>(tag, L, n, v) )
+        stack::type_error<T>(L, n);
+
+    return v;
 }
 
 template<typename T>
-inline T getx(lua_State* L, int n)
+inline T getx(tags::user, lua_State* L, int n)
+{
+    auto p = try_get<T>(tags::user(), L, n);
+    if ( !p )
+        stack::type_error<T>(L, n);
+
+    return *p;
+}
+
+template<typename T>
+inline T getx(tags::user_ptr, lua_State* L, int n)
 {
-    check<T>(L, n);
-    return cast<T>(L, n);
+    auto p = try_get<T>(tags::user(), L, n);
+    if ( !p )
+        stack::type_error<T>(L, n);
+
+    return p;
 }
 
+} // namespace impl
+
+namespace stack
+{
+
+// checks and converts in one pass; the TypeError is only built on failure
+template<typename T>
+inline T getx(lua_State* L, int n)
+{ return impl::getx<T>(typename traits::trait<T>::tag(), L, n); }
+
 } // namespace stack
 
 }
@@ -18,6 +18,10 @@ template<typename T>
 struct trait<T, enable_for<is_enum<T>()>>
 { using tag = tags::enumeration; };
 
+template<typename T>
+struct lua_type_code<T, enable_for<is_enum<T>()>>
+{ static constexpr auto value = LUA_TNUMBER; };
+
 } // namespace traits
 
 namespace impl
@@ -37,7 +41,7 @@ inline bool is(tags::enumeration, lua_State* L, int n)
 }
 
 template<typename T>
-inline std::string type_name(tags::enumeration)
+inline const char* type_name(tags::enumeration, lua_State*)
 { return "enumeration"; }
 
 template<typename T>
@@ -48,6 +52,23 @@ template<typename T>
 inline T cast(tags::enumeration, lua_State* L, int n)
 { return static_cast<T>(lua_tointeger(L, n)); }
 
+template<typename T>
+inline bool try_get(tags::enumeration, lua_State* L, int n, T& v)
+{
+    using u_type = typename std::underlying_type<T>::type;
+
+    if ( lua_type(L, n) != LUA_TNUMBER )
+        return false;
+
+    auto val = lua_tointeger(L, n);
+    if ( val < std::numeric_limits<u_type>::min() or
+        val > std::numeric_limits<u_type>::max() )
+        return false;
+
+    v = static_cast<T>(val);
+    return true;
+}
+
 } // namespace impl
 
 }
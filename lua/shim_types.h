@@ -1,10 +1,30 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <map>
 #include <string>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+#if __cplusplus > 201703L and defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#define LUA_SHIM_STD_SPAN
+#endif
+#endif
 
 #include <luajit-2.0/lua.hpp>
 
+#include "lua_span.h"
+#include "lua_string_cache.h"
+#include "lua_string_span.h"
+
 // type traits helpers
 
 namespace Lua
@@ -65,14 +85,97 @@ template<typename T>
 constexpr bool is_std_str()
 { return is_same<T, std::string>(); }
 
+// borrowed strings
+template<typename T>
+constexpr bool is_str_view()
+{
+#if __cplusplus >= 201703L
+    if ( is_same<T, std::string_view>() )
+        return true;
+#endif
+    return is_same<T, StringSpan>();
+}
+
+// cached constant strings, push only
+template<typename T>
+constexpr bool is_key()
+{ return is_same<T, Key>(); }
+
 template<typename T>
 constexpr bool is_str()
-{ return is_std_str<T>() or is_c_str<T>(); }
+{
+    return is_std_str<T>() or is_c_str<T>() or is_str_view<T>() or
+        is_key<T>();
+}
 
 template<typename T>
 constexpr bool is_builtin()
 { return is_bool<T>() or is_num<T>() or is_str<T>(); }
 
+// containers marshaled to and from Lua tables
+
+template<typename T>
+struct vector_type : std::false_type {};
+
+template<typename T, typename A>
+struct vector_type<std::vector<T, A>> : std::true_type {};
+
+template<typename T>
+struct array_type : std::false_type {};
+
+template<typename T, std::size_t N>
+struct array_type<std::array<T, N>> : std::true_type {};
+
+template<typename T>
+struct span_type : std::false_type {};
+
+template<typename T>
+struct span_type<Span<T>> : std::true_type {};
+
+#ifdef LUA_SHIM_STD_SPAN
+template<typename T, std::size_t N>
+struct span_type<std::span<T, N>> : std::true_type {};
+#endif
+
+template<typename T>
+struct map_type : std::false_type {};
+
+template<typename K, typename V, typename C, typename A>
+struct map_type<std::map<K, V, C, A>> : std::true_type {};
+
+template<typename T>
+struct unordered_map_type : std::false_type {};
+
+template<typename K, typename V, typename H, typename E, typename A>
+struct unordered_map_type<std::unordered_map<K, V, H, E, A>> : std::true_type {};
+
+template<typename T>
+constexpr bool is_vector()
+{ return vector_type<typename std::remove_const<T>::type>::value; }
+
+template<typename T>
+constexpr bool is_std_array()
+{ return array_type<typename std::remove_const<T>::type>::value; }
+
+template<typename T>
+constexpr bool is_span()
+{ return span_type<typename std::remove_const<T>::type>::value; }
+
+template<typename T>
+constexpr bool is_map()
+{ return map_type<typename std::remove_const<T>::type>::value; }
+
+template<typename T>
+constexpr bool is_unordered_map()
+{ return unordered_map_type<typename std::remove_const<T>::type>::value; }
+
+template<typename T>
+constexpr bool is_container()
+{
+    return is_vector<T>() or is_std_array<T>() or is_span<T>() or
+        is_map<T>() or is_unordered_map<T>();
+}
+
 template<bool B, typename T = void>
 using enable_for = typename std::enable_if<B, T>::type;
 
@@ -90,7 +193,7 @@ struct base<T, enable_for<std::is_pointer<T>::value>>
 
 template<typename T>
 constexpr bool is_user_object()
-{ return std::is_class<T>::value and !is_builtin<T>(); }
+{ return std::is_class<T>::value and !is_builtin<T>() and !is_container<T>(); }
 
 template<typename T>
 constexpr bool is_user_ref()
@@ -1,8 +1,9 @@
 #pragma once
 
+#include <utility>
+
 #include "shim_defs.h"
 #include "shim_types.h"
-#include "lua_pop.h"
 #include "lua_userdata.h"
 #include "lua_util.h"
 
@@ -37,45 +38,76 @@ inline bool is(tags::user, lua_State* L, int n)
     if ( lua_type(L, n) != traits::lua_type_code<T>::value )
         return false;
 
-    const auto& name =
-        traits::type_name_storage<typename util::base<T>::type>::value;
+    // can't do further comparison for an unregistered type
+    auto entry = util::find_type<T>(L);
+    if ( !entry )
+        return false;
 
-    // can't do further comparison w/out type name
-    if ( name.empty() )
+    if ( !lua_getmetatable(L, n) )
         return false;
 
-    // we'll be altering the stack, so we need the absolute index
-    auto idx = util::abs_index(lua_gettop(L), n);
+    auto meta = lua_topointer(L, -1);
+    lua_pop(L, 1);
 
-    Pop pop(L);
+    return meta == entry->meta;
+}
 
-    lua_getmetatable(L, idx);
-    if ( !lua_istable(L, -1) )
-        return false;
+// returns the object held at n, or nullptr if n doesn't hold a T.
+// lua_touserdata stands in for the lua_type probe
+template<typename T>
+inline typename util::base<T>::type* try_get(tags::user, lua_State* L, int n)
+{
+    auto h = static_cast<typename util::base<T>::type**>(lua_touserdata(L, n));
+    if ( !h )
+        return nullptr;
+
+    auto entry = util::find_type<T>(L);
+    if ( !entry or !lua_getmetatable(L, n) )
+        return nullptr;
+
+    auto meta = lua_topointer(L, -1);
+    lua_pop(L, 1);
 
-    luaL_getmetatable(L, name.c_str());
-    return lua_rawequal(L, -2, -1);
+    return ( meta == entry->meta ) ? *h : nullptr;
 }
 
 template<typename T>
-inline std::string type_name(tags::user)
+inline const char* type_name(tags::user, lua_State* L)
 {
-    const auto& name = traits::type_name_storage<T>::value;
-    if ( name.empty() )
+    auto entry = util::find_type<T>(L);
+    if ( !entry )
         return "unregistered userdata";
 
-    return name;
+    return entry->name.c_str();
 }
 
-// Disable pushing for user data structures
-// template<typename T>
-// inline void push(tags::user, lua_State* L, const T val)
-// { userdata<T>::push(L, val); }
+// user objects are copied or moved into a new userdata block, which owns
+// them; T must be registered in this state
+template<typename T, typename U>
+inline void push(tags::user, lua_State* L, U&& val)
+{
+    util::userdata<T>::emplace(L, std::forward<U>(val));
+    util::userdata<T>::assign_metatable(L, -1);
+}
 
-// template<typename T>
-// inline void push(tags::user_ptr, lua_State* L, T val)
-// { userdata<T>::push(L, *val); }
+// pointers are pushed as non-owning references; nullptr becomes nil
+template<typename T>
+inline void push(tags::user_ptr, lua_State* L, T val)
+{
+    using base_type = typename util::base<T>::type;
+
+    if ( !val )
+    {
+        lua_pushnil(L);
+        return;
+    }
+
+    util::userdata<T>::push(L, const_cast<base_type&>(*val));
+    util::userdata<T>::assign_metatable(L, -1);
+}
 
+// returns a reference to the stored object when T is a reference type,
+// otherwise a copy of it
 template<typename T>
 inline T cast(tags::user, lua_State* L, int n)
 {
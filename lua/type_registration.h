@@ -6,7 +6,12 @@
 
 #include "shim_types.h"
 #include "lua_pop.h"
+#include "lua_string_cache.h"
 #include "functional_pushers.h"
+#include "functional_overloads.h"
+#include "lua_ffi.h"
+#include "lua_proxy.h"
+#include "lua_property.h"
 
 namespace Lua
 {
@@ -19,6 +24,7 @@ struct TypeInfo
     std::string name = "";
     int methods = 0;
     int meta = 0;
+    int properties = 0;
     bool has_ctor = false;
     bool has_dtor = false;
     bool has_tostring = false;
@@ -29,27 +35,56 @@ struct TypeInfo
 namespace detail
 {
 
-inline bool check_key(lua_State* L, int table, const char* key, int type)
+// the names registration reads and sets on every type, pinned once per
+// state in its StringCache
+struct keys
+{
+    static const Key& index()
+    { static const Key k("__index"); return k; }
+
+    static const Key& newindex()
+    { static const Key k("__newindex"); return k; }
+
+    static const Key& gc()
+    { static const Key k("__gc"); return k; }
+
+    static const Key& tostring()
+    { static const Key k("__tostring"); return k; }
+
+    static const Key& methods()
+    { static const Key k("__methods"); return k; }
+
+    static const Key& properties()
+    { static const Key k("__properties"); return k; }
+
+    static const Key& ctor()
+    { static const Key k("new"); return k; }
+};
+
+inline bool check_key(lua_State* L, StringCache& strings, int table,
+    const Key& key, int type)
 {
     Pop pop(L);
 
-    lua_pushstring(L, key);
+    strings.push(L, key);
     lua_rawget(L, table);
 
     return lua_type(L, -1) == type;
 }
 
-inline int get_key(lua_State* L, int table, const char* key)
+inline int get_key(lua_State* L, StringCache& strings, int table,
+    const Key& key)
 {
-    lua_pushstring(L, key);
+    strings.push(L, key);
     lua_rawget(L, table);
     return lua_gettop(L);
 }
 
-registration::TypeInfo open_type(lua_State* L, const char* name)
+inline registration::TypeInfo open_type(lua_State* L, const char* name)
 {
     assert(name);
 
+    auto& strings = StringCache::open(L);
     registration::TypeInfo info;
     info.name = name;
 
@@ -62,21 +97,34 @@ registration::TypeInfo open_type(lua_State* L, const char* name)
     {
         // check for __gc
         info.has_dtor =
-            detail::check_key(L, info.meta, "__gc", LUA_TFUNCTION);
+            detail::check_key(L, strings, info.meta, keys::gc(), LUA_TFUNCTION);
 
         // check for __tostring
         info.has_tostring =
-            detail::check_key(L, info.meta, "__tostring", LUA_TFUNCTION);
+            detail::check_key(L, strings, info.meta, keys::tostring(),
+                LUA_TFUNCTION);
 
         // access the methods table
         info.methods =
-            detail::get_key(L, info.meta, "__index");
+            detail::get_key(L, strings, info.meta, keys::index());
+
+        // with properties, __index is a closure over the methods table and
+        // the property table, which the metatable also keeps
+        if ( lua_iscfunction(L, info.methods) )
+        {
+            info.methods =
+                detail::get_key(L, strings, info.meta, keys::methods());
+
+            info.properties =
+                detail::get_key(L, strings, info.meta, keys::properties());
+        }
 
         assert(lua_istable(L, info.methods));
 
         // check for ctor
         info.has_ctor =
-            detail::check_key(L, info.methods, "new", LUA_TFUNCTION);
+            detail::check_key(L, strings, info.methods, keys::ctor(),
+                LUA_TFUNCTION);
     }
 
     else
@@ -85,7 +133,7 @@ registration::TypeInfo open_type(lua_State* L, const char* name)
         info.methods = lua_gettop(L);
 
         // set methods table as metatable index
-        lua_pushstring(L, "__index");
+        strings.push(L, keys::index());
         lua_pushvalue(L, info.methods);
         lua_rawset(L, info.meta);
 
@@ -114,7 +162,7 @@ struct default_ctor_adder<T, util::enable_for<has_default_ctor<T>()>>
 {
     static bool add(lua_State* L, int t)
     {
-        lua_pushliteral(L, "new");
+        StringCache::open(L).push(L, keys::ctor());
         detail::constructor_pusher<T>::push(L);
         lua_rawset(L, t);
         return true;
@@ -126,23 +174,31 @@ struct default_ctor_adder<T, util::enable_for<has_default_ctor<T>()>>
 namespace registration
 {
 
-template<typename T>
+// Policy (policy::checked by default) applies to every binding added
+// through the editor, unless a method names its own
+template<typename T, typename Policy = policy::checked>
 class Editor
 {
 public:
+    // reopens a type already registered in this state
     Editor(lua_State* L) :
-        L(L), pop(new Pop(L)), info(L, traits::type_name_storage<T>::value)
-    { }
+        L(L), pop(new Pop(L)), strings(StringCache::open(L)),
+        entry(util::find_type<T>(L))
+    {
+        assert(entry);
+        info = detail::open_type(L, entry->name.c_str());
+    }
 
     Editor(lua_State* L, const char* name) :
-        L(L), pop(new Pop(L)), info(detail::open_type(L, name))
-    { traits::type_name_storage<T>::value = name; }
+        L(L), pop(new Pop(L)), strings(StringCache::open(L)),
+        info(detail::open_type(L, name))
+    { entry = &util::TypeRegistry::open(L).add<T>(L, name, info.meta); }
 
     // disable copy construction
     Editor(const Editor&) = delete;
 
     Editor(Editor&& o) :
-        L(o.L), pop(o.pop), info(o.info)
+        L(o.L), pop(o.pop), strings(o.strings), entry(o.entry), info(o.info)
     { o.pop = nullptr; }
 
     ~Editor()
@@ -164,10 +220,14 @@ public:
 
             if ( !info.has_tostring )
             {
-                push_function(info.meta, "__tostring", tostring_proxy);
+                push_function<policy::checked>(info.meta,
+                    detail::keys::tostring(), tostring_proxy);
                 info.has_tostring = true;
             }
 
+            if ( info.properties )
+                install_properties();
+
             delete pop;
             pop = nullptr;
         }
@@ -175,9 +235,105 @@ public:
 
     template<typename F>
     Editor& add_method(const char* key, F fn)
+    { return add_method<Policy>(key, fn); }
+
+    // with a policy of its own, e.g. add_method<policy::trusted>("f", &T::f)
+    template<typename MethodPolicy, typename F>
+    Editor& add_method(const char* key, F fn)
+    {
+        assert(pop);
+        push_function<MethodPolicy>(info.methods, key, fn);
+        ++entry->method_count;
+        return *this;
+    }
+
+    // binds a function pointer known at compile time, e.g.
+    //     add_method<decltype(&T::f), &T::f>("f")
+    // under policy::ffi it is exported through the LuaJIT FFI if it can be
+    template<typename F, F fn, typename MethodPolicy = Policy>
+    Editor& add_method(const char* key)
+    {
+        assert(pop);
+        lua_pushstring(L, key);
+        detail::binding_pusher<F, fn, MethodPolicy>::push(L);
+        set_function(info.methods, key);
+        ++entry->method_count;
+        return *this;
+    }
+
+    // binds several function pointers under one name, e.g.
+    //     add_method("f", &T::f1, &T::f2)
+    template<typename F1, typename F2, typename... Fs>
+    Editor& add_method(const char* key, F1 f1, F2 f2, Fs... fns)
+    {
+        assert(pop);
+        lua_pushstring(L, key);
+        detail::overload_pusher<F1, F2, Fs...>::template
+            push<Policy>(L, f1, f2, fns...);
+        set_function(info.methods, key);
+        ++entry->method_count;
+        return *this;
+    }
+
+#if __cplusplus >= 201703L
+    // same as above, e.g. add_method<&T::f>("f")
+    template<auto fn, typename MethodPolicy = Policy>
+    Editor& add_method(const char* key)
+    { return add_method<decltype(fn), fn, MethodPolicy>(key); }
+#endif
+
+    // binds a method returning a live view of a container member, e.g.
+    //     add_proxy("items", &T::items)
+    // the view keeps its object alive
+    template<typename C>
+    Editor& add_proxy(const char* key, C T::* member)
+    {
+        assert(pop);
+        lua_pushstring(L, key);
+        detail::member_proxy_pusher<T, C>::push(L, member);
+        set_function(info.methods, key);
+        ++entry->method_count;
+        return *this;
+    }
+
+    // binds a data member as obj.key, e.g.
+    //     add_property("x", &T::x)
+    // const members are read-only. members of base classes work too
+    template<typename M, typename C>
+    Editor& add_property(const char* key, M C::* member)
+    {
+        static_assert(std::is_base_of<C, T>::value, "not a member of T");
+
+        assert(pop);
+        properties().add(key, new detail::member_property<T, M, Policy>(member));
+        return *this;
+    }
+
+    // binds a read-only property through a getter, e.g.
+    //     add_property("size", &T::size)
+    template<typename R, typename C>
+    Editor& add_property(const char* key, R (C::*getter)() const)
+    {
+        static_assert(std::is_base_of<C, T>::value, "not a method of T");
+
+        assert(pop);
+        properties().add(key, new detail::accessor_property<T, R, void, R, Policy>(
+            getter, nullptr));
+        return *this;
+    }
+
+    // binds a property through a getter and a setter, e.g.
+    //     add_property("name", &T::get_name, &T::set_name)
+    template<typename R, typename SR, typename A, typename C, typename D>
+    Editor& add_property(const char* key, R (C::*getter)() const,
+        SR (D::*setter)(A))
     {
+        static_assert(std::is_base_of<C, T>::value and
+            std::is_base_of<D, T>::value, "not a method of T");
+
         assert(pop);
-        push_function(info.methods, key, fn);
+        properties().add(key, new detail::accessor_property<T, R, SR, A, Policy>(
+            getter, setter));
         return *this;
     }
 
@@ -185,7 +341,7 @@ public:
     Editor& add_ctor(F fn)
     {
         assert(pop);
-        push_function(info.methods, "new", fn);
+        push_function<Policy>(info.methods, detail::keys::ctor(), fn);
         info.has_ctor = true;
         return *this;
     }
@@ -194,9 +350,22 @@ public:
     Editor& add_ctor()
     {
         assert(pop);
-        lua_pushstring(L, "new");
-        detail::constructor_pusher<T, Args...>::push(L);
-        lua_rawset(L, info.methods);
+        strings.push(L, detail::keys::ctor());
+        detail::constructor_pusher<T, Args...>::template push<Policy>(L);
+        set_function(info.methods, detail::keys::ctor().data());
+        info.has_ctor = true;
+        return *this;
+    }
+
+    // binds several constructors as one overloaded "new", e.g.
+    //     add_ctors<void(), void(int), void(int, int)>()
+    template<typename... Sigs>
+    Editor& add_ctors()
+    {
+        assert(pop);
+        strings.push(L, detail::keys::ctor());
+        detail::ctor_overload_pusher<T, Sigs...>::template push<Policy>(L);
+        set_function(info.methods, detail::keys::ctor().data());
         info.has_ctor = true;
         return *this;
     }
@@ -205,7 +374,7 @@ public:
     Editor& add_dtor(F fn)
     {
         assert(pop);
-        push_function(info.meta, "__gc", fn);
+        push_function<policy::checked>(info.meta, detail::keys::gc(), fn);
         info.has_dtor = true;
         return *this;
     }
@@ -213,9 +382,9 @@ public:
     Editor& add_dtor()
     {
         assert(pop);
-        lua_pushstring(L, "__gc");
+        strings.push(L, detail::keys::gc());
         detail::destructor_pusher<T>::push(L);
-        lua_rawset(L, info.meta);
+        set_function(info.meta, detail::keys::gc().data());
         info.has_dtor = true;
         return *this;
     }
@@ -224,40 +393,109 @@ public:
     { return info; }
 
 private:
+    util::PropertyTable& properties()
+    {
+        if ( !info.properties )
+        {
+            util::PropertyTable::push(L);
+            info.properties = lua_gettop(L);
+        }
+
+        return util::PropertyTable::get(L, info.properties);
+    }
+
+    // methods are still looked up first, in the methods table; everything
+    // else goes through the property table's perfect hash
+    void install_properties()
+    {
+        properties().build(L, info.properties);
+
+        strings.push(L, detail::keys::methods());
+        lua_pushvalue(L, info.methods);
+        lua_rawset(L, info.meta);
+
+        strings.push(L, detail::keys::properties());
+        lua_pushvalue(L, info.properties);
+        lua_rawset(L, info.meta);
+
+        strings.push(L, detail::keys::index());
+        push_property_closure(detail::property_index);
+        set_function(info.meta, detail::keys::index().data());
+
+        strings.push(L, detail::keys::newindex());
+        push_property_closure(detail::property_newindex);
+        set_function(info.meta, detail::keys::newindex().data());
+    }
+
+    void push_property_closure(lua_CFunction fn)
+    {
+        lua_pushvalue(L, info.methods);
+        lua_pushvalue(L, info.properties);
+        lua_pushstring(L, info.name.c_str());
+        lua_pushvalue(L, info.meta);
+        lua_pushcclosure(L, fn, 4);
+    }
+
     void add_default_ctor()
     {
         if ( detail::default_ctor_adder<T>::add(L, info.methods) )
+        {
             info.has_ctor = true;
+
+            strings.push(L, detail::keys::ctor());
+            lua_rawget(L, info.methods);
+            util::name_function(L, -1, info.name + ":new");
+            lua_pop(L, 1);
+        }
     }
 
-    template<typename F>
+    template<typename FunctionPolicy, typename F>
     void push_function(int table, const char* key, F fn)
     {
         lua_pushstring(L, key);
-        detail::auto_pusher<F>::push(L, fn);
+        detail::auto_pusher<F>::template push<FunctionPolicy>(L, fn);
+        set_function(table, key);
+    }
+
+    template<typename FunctionPolicy, typename F>
+    void push_function(int table, const Key& key, F fn)
+    {
+        strings.push(L, key);
+        detail::auto_pusher<F>::template push<FunctionPolicy>(L, fn);
+        set_function(table, key.data());
+    }
+
+    // sets table[key] from the key and function on top of the stack,
+    // naming the function "Class:key" for diagnostics
+    void set_function(int table, const char* key)
+    {
+        util::name_function(L, -1, info.name + ":" + key);
         lua_rawset(L, table);
     }
 
     lua_State* L;
     Pop* pop;
+    StringCache& strings;
+    util::TypeEntry* entry = nullptr;
     TypeInfo info;
 
     // FIXIT-L find a better spot for this
     static int tostring_proxy(lua_State* L)
     {
-        stack::push(L, stack::type_name<T>().c_str());
+        stack::push(L, stack::type_name<T>(L));
         return 1;
     }
 };
 
 } // namespace registration
 
-template<typename T>
-inline registration::Editor<T> open_class(lua_State* L)
-{ return registration::Editor<T>(L); }
+template<typename T, typename Policy = policy::checked>
+inline registration::Editor<T, Policy> open_class(lua_State* L)
+{ return registration::Editor<T, Policy>(L); }
 
-template<typename T>
-inline registration::Editor<T> register_class(lua_State* L, std::string name)
-{ return registration::Editor<T>(L, name); }
+template<typename T, typename Policy = policy::checked>
+inline registration::Editor<T, Policy> register_class(lua_State* L,
+    std::string name)
+{ return registration::Editor<T, Policy>(L, name.c_str()); }
 
 }
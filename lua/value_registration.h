@@ -0,0 +1,475 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "lua_ffi.h"
+#include "lua_pop.h"
+
+// value types registered as LuaJIT FFI metatypes: objects are plain cdata
+// structs, so creating one allocates no userdata and needs no finalizer,
+// fields are read and written by JIT-compiled loads and stores, and
+// methods are FFI calls
+
+namespace Lua
+{
+
+namespace util
+{
+
+// offset of a data member. no T is constructed, the pointer into the
+// buffer is only used for address arithmetic, like offsetof
+template<typename T, typename M>
+inline std::size_t offset_of(M T::* field)
+{
+    alignas(T) static char buf[sizeof(T)];
+    auto p = reinterpret_cast<const T*>(buf);
+    return reinterpret_cast<const char*>(&(p->*field)) - buf;
+}
+
+// C declaration of a field named key, e.g. "float v[3]"
+template<typename M>
+struct field_ctype
+{
+    static std::string decl(const std::string& key)
+    { return ctype<M>::name() + " " + key; }
+};
+
+template<typename M, std::size_t N>
+struct field_ctype<M[N]>
+{
+    static std::string decl(const std::string& key)
+    { return field_ctype<M>::decl(key + "[" + std::to_string(N) + "]"); }
+};
+
+// a C declaration of T, with the registered fields at their offsets in
+// T and padding over everything else
+template<typename T>
+class StructLayout
+{
+public:
+    template<typename M>
+    void add(const char* key, M T::* field)
+    {
+        fields.push_back({ key, offset_of(field), sizeof(M),
+            field_ctype<M>::decl(key) });
+        align = std::max(align, alignof(M));
+    }
+
+    // e.g. "typedef struct { float x; float y; } Vec2;"
+    std::string declaration(const std::string& name) const
+    { return "typedef " + body() + " " + name + ";"; }
+
+    // the anonymous struct, e.g. "struct { float x; float y; }"
+    std::string body() const
+    {
+        auto sorted = fields;
+        std::sort(sorted.begin(), sorted.end(),
+            [](const Field& a, const Field& b) { return a.offset < b.offset; });
+
+        std::string s = "struct ";
+
+        // e.g. a field left out was more aligned than all the others
+        if ( align < alignof(T) )
+            s += "__attribute__((aligned(" + std::to_string(alignof(T)) + "))) ";
+
+        s += "{ ";
+
+        std::size_t end = 0;
+        for ( const auto& f : sorted )
+        {
+            assert(f.offset >= end);
+            s += padding(f.offset, end);
+            s += f.decl + "; ";
+            end = f.offset + f.size;
+        }
+
+        s += padding(sizeof(T), end);
+        return s + "}";
+    }
+
+    struct Field
+    {
+        std::string key;
+        std::size_t offset;
+        std::size_t size;
+        std::string decl;
+    };
+
+    const std::vector<Field>& members() const
+    { return fields; }
+
+private:
+    static std::string padding(std::size_t to, std::size_t from)
+    {
+        if ( to == from )
+            return "";
+
+        return "uint8_t pad_" + std::to_string(from) + "[" +
+            std::to_string(to - from) + "]; ";
+    }
+
+    std::vector<Field> fields;
+    std::size_t align = 1;
+};
+
+} // namespace util
+
+namespace detail
+{
+
+// the C type of X in the methods of value type T, which may take and
+// return T by value
+template<typename T, typename X, bool = std::is_same<T, X>::value>
+struct value_ctype
+{
+    static constexpr bool arg = util::is_ffi_arg<X>();
+    static constexpr bool ret = util::is_ffi_return<X>();
+
+    static std::string name(const std::string&)
+    { return util::ctype<X>::name(); }
+};
+
+template<typename T, typename X>
+struct value_ctype<T, X, true>
+{
+    static constexpr bool arg = true;
+    static constexpr bool ret = true;
+
+    static std::string name(const std::string& self)
+    { return self; }
+};
+
+template<typename T, typename... Args>
+struct value_args : std::true_type {};
+
+template<typename T, typename X, typename... Args>
+struct value_args<T, X, Args...> : std::integral_constant<bool,
+    value_ctype<T, X>::arg and value_args<T, Args...>::value> {};
+
+template<typename T>
+inline std::string value_params(const std::string&)
+{ return ""; }
+
+template<typename T, typename X, typename... Args>
+inline std::string value_params(const std::string& self)
+{
+    auto s = value_ctype<T, X>::name(self);
+    if ( sizeof...(Args) )
+        s += ", " + value_params<T, Args...>(self);
+
+    return s;
+}
+
+// e.g. "float (*)(const Vec2 *, Vec2)"
+template<typename T, typename Return, typename... Args>
+inline std::string value_signature(const std::string& self,
+    const std::string& first = "")
+{
+    auto params = value_params<T, Args...>(self);
+    if ( !first.empty() )
+        params = params.empty() ? first : first + ", " + params;
+
+    return value_ctype<T, Return>::name(self) + " (*)(" +
+        ( params.empty() ? "void" : params ) + ")";
+}
+
+// like ffi_trampoline, but self is a pointer to the struct itself
+template<typename T, typename F, F fn>
+struct value_trampoline {};
+
+template<typename T, typename Return, typename... Args, Return(*fn)(Args...)>
+struct value_trampoline<T, Return(*)(Args...), fn>
+{
+    static constexpr bool exportable =
+        value_ctype<T, Return>::ret and value_args<T, Args...>::value;
+
+    static constexpr bool method = false;
+    static constexpr int arity = sizeof...(Args);
+    static constexpr bool nothrow = noexcept(fn(std::declval<Args>()...));
+
+    static Return call(Args... args) noexcept
+    { return fn(args...); }
+
+    static std::string signature(const std::string& self)
+    { return value_signature<T, Return, Args...>(self); }
+};
+
+template<typename T, typename Return, typename Class, typename... Args,
+    Return(Class::*fn)(Args...)>
+struct value_trampoline<T, Return(Class::*)(Args...), fn>
+{
+    static constexpr bool exportable =
+        value_ctype<T, Return>::ret and value_args<T, Args...>::value;
+
+    static constexpr bool method = true;
+    static constexpr int arity = sizeof...(Args);
+    static constexpr bool nothrow =
+        noexcept((std::declval<T&>().*fn)(std::declval<Args>()...));
+
+    // self is checked on the Lua side, see push_self_check
+    static Return call(T* self, Args... args) noexcept
+    { return (self->*fn)(args...); }
+
+    static std::string signature(const std::string& self)
+    { return value_signature<T, Return, Args...>(self, self + " *"); }
+};
+
+template<typename T, typename Return, typename Class, typename... Args,
+    Return(Class::*fn)(Args...) const>
+struct value_trampoline<T, Return(Class::*)(Args...) const, fn>
+{
+    static constexpr bool exportable =
+        value_ctype<T, Return>::ret and value_args<T, Args...>::value;
+
+    static constexpr bool method = true;
+    static constexpr int arity = sizeof...(Args);
+    static constexpr bool nothrow =
+        noexcept((std::declval<const T&>().*fn)(std::declval<Args>()...));
+
+    static Return call(const T* self, Args... args) noexcept
+    { return (self->*fn)(args...); }
+
+    static std::string signature(const std::string& self)
+    { return value_signature<T, Return, Args...>(self, "const " + self + " *"); }
+};
+
+// calls ffi[fn] with the nargs values on top of the stack, leaving nresults
+inline bool call_ffi(lua_State* L, int ffi, const char* fn, int nargs,
+    int nresults)
+{
+    lua_getfield(L, ffi, fn);
+    lua_insert(L, -nargs - 1);
+    return !lua_pcall(L, nargs, nresults, 0);
+}
+
+// replaces the method on top of the stack with a Lua function checking
+// self first: the FFI passes nil as a null pointer, and the method can't
+// raise an error itself. the parameters are spelled out rather than
+// passed as ..., which keeps the wrapper compiled into traces
+inline bool push_self_check(lua_State* L, const std::string& name, int arity)
+{
+    std::string params = "self";
+    for ( int i = 1; i <= arity; ++i )
+        params += ", a" + std::to_string(i);
+
+    auto code =
+        "local fn = ...\n"
+        "return function(" + params + ")\n"
+        "    if self == nil then\n"
+        "        error(\"TypeError: (arg #1) expected '" + name +
+        "', got 'nil'\", 0)\n"
+        "    end\n"
+        "    return fn(" + params + ")\n"
+        "end";
+
+    if ( luaL_loadbuffer(L, code.c_str(), code.size(), name.c_str()) )
+        return false;
+
+    lua_insert(L, -2);
+    return !lua_pcall(L, 1, 1, 0);
+}
+
+} // namespace detail
+
+namespace registration
+{
+
+// registers T as an FFI struct: its fields and methods are declared here,
+// and everything happens at finish(). T is then constructed from Lua by
+// calling the type, e.g. Vec2(1, 2), which initializes the declared fields
+// in order. each type is registered once per state
+template<typename T>
+class ValueEditor
+{
+    static_assert(std::is_standard_layout<T>::value and
+        std::is_trivially_copyable<T>::value,
+        "value types must be standard-layout and trivially copyable");
+
+public:
+    ValueEditor(lua_State* L, const char* name) :
+        L(L), name(name), open(true) { }
+
+    ValueEditor(const ValueEditor&) = delete;
+
+    ValueEditor(ValueEditor&& o) :
+        L(o.L), name(std::move(o.name)), layout(std::move(o.layout)),
+        methods(std::move(o.methods)), open(o.open), registered(o.registered)
+    { o.open = false; }
+
+    // a chained registration has nothing to return its result to, so it
+    // has to succeed; call finish() to handle failure instead
+    ~ValueEditor()
+    {
+        if ( open )
+        {
+            bool ok = finish();
+            assert(ok and "value type registration failed");
+            (void)ok;
+        }
+    }
+
+    ValueEditor& operator=(const ValueEditor&) = delete;
+    ValueEditor& operator=(ValueEditor&&) = delete;
+
+    template<typename M>
+    ValueEditor& add_field(const char* key, M T::* field)
+    {
+        assert(open);
+        layout.add(key, field);
+        return *this;
+    }
+
+    // binds a function pointer known at compile time, e.g.
+    //     add_method<decltype(&T::f), &T::f>("f")
+    template<typename F, F fn>
+    ValueEditor& add_method(const char* key)
+    {
+        using trampoline = detail::value_trampoline<T, F, fn>;
+
+        static_assert(trampoline::exportable,
+            "value type methods must have C signatures");
+
+        static_assert(trampoline::nothrow,
+            "value type methods must be noexcept");
+
+        assert(open);
+        methods.push_back({ key, trampoline::signature(name),
+            reinterpret_cast<void*>(&trampoline::call),
+            trampoline::method ? trampoline::arity : -1 });
+        return *this;
+    }
+
+#if __cplusplus >= 201703L
+    // same as above, e.g. add_method<&T::f>("f")
+    template<auto fn>
+    ValueEditor& add_method(const char* key)
+    { return add_method<decltype(fn), fn>(key); }
+#endif
+
+    // returns false if the FFI isn't available or rejects the declaration,
+    // if it lays the struct out differently from T, or if a method can't be
+    // cast. the layout is checked on an anonymous struct first, so the name
+    // is only defined once it's known to be right. the method signatures
+    // need the name, though, and a cdef can't be undone: if a method fails,
+    // the name stays declared to the FFI, but no global or metatype is set
+    bool finish()
+    {
+        if ( !open )
+            return registered;
+
+        open = false;
+
+        Pop pop(L);
+
+        if ( !util::push_ffi(L) )
+            return false;
+
+        auto ffi = lua_gettop(L);
+
+        auto body = layout.body();
+        lua_pushlstring(L, body.c_str(), body.size());
+        if ( !detail::call_ffi(L, ffi, "typeof", 1, 1) or !check_layout(ffi) )
+            return false;
+
+        auto decl = declaration();
+        lua_pushlstring(L, decl.c_str(), decl.size());
+        if ( !detail::call_ffi(L, ffi, "cdef", 1, 0) )
+            return false;
+
+        lua_createtable(L, 0, methods.size());
+        auto table = lua_gettop(L);
+
+        for ( const auto& m : methods )
+        {
+            lua_pushlstring(L, m.signature.c_str(), m.signature.size());
+            lua_pushlightuserdata(L, m.fn);
+            if ( !detail::call_ffi(L, ffi, "cast", 2, 1) )
+                return false;
+
+            if ( m.arity >= 0 and !detail::push_self_check(L, name, m.arity) )
+                return false;
+
+            lua_setfield(L, table, m.key.c_str());
+        }
+
+        lua_pushstring(L, name.c_str());
+        lua_createtable(L, 0, 1);
+        lua_pushvalue(L, table);
+        lua_setfield(L, -2, "__index");
+        if ( !detail::call_ffi(L, ffi, "metatype", 2, 1) )
+            return false;
+
+        lua_setglobal(L, name.c_str());
+
+        registered = true;
+        return true;
+    }
+
+    std::string declaration() const
+    { return layout.declaration(name); }
+
+private:
+    // checks the ctype on top of the stack against T
+    bool check_layout(int ffi)
+    {
+        auto ct = lua_gettop(L);
+
+        if ( !check_layout(ffi, ct, "sizeof", nullptr, sizeof(T)) or
+            !check_layout(ffi, ct, "alignof", nullptr, alignof(T)) )
+            return false;
+
+        for ( const auto& f : layout.members() )
+        {
+            if ( !check_layout(ffi, ct, "offsetof", f.key.c_str(), f.offset) )
+                return false;
+        }
+
+        return true;
+    }
+
+    bool check_layout(int ffi, int ct, const char* fn, const char* field,
+        std::size_t expected)
+    {
+        lua_pushvalue(L, ct);
+
+        if ( field )
+            lua_pushstring(L, field);
+
+        if ( !detail::call_ffi(L, ffi, fn, field ? 2 : 1, 1) )
+            return false;
+
+        auto n = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+        return static_cast<std::size_t>(n) == expected;
+    }
+
+    struct Method
+    {
+        std::string key;
+        std::string signature;
+        void* fn;
+        int arity;  // of a method, not counting self; -1 for functions
+    };
+
+    lua_State* L;
+    std::string name;
+    util::StructLayout<T> layout;
+    std::vector<Method> methods;
+    bool open;
+    bool registered = false;
+};
+
+} // namespace registration
+
+template<typename T>
+inline registration::ValueEditor<T> register_value(lua_State* L,
+    std::string name)
+{ return registration::ValueEditor<T>(L, name.c_str()); }
+
+}
@@ -0,0 +1,279 @@
+#include <cstdlib>
+#include <new>
+
+#include "type_registration.h"
+
+#include "common.h"
+
+// replaces the global allocation functions for the whole test binary;
+// allocations are only counted inside an AllocationCounter scope
+
+namespace t_allocations
+{
+// -----------------------------------------------------------------------------
+// fixtures
+// -----------------------------------------------------------------------------
+
+static bool counting = false;
+static size_t cxx_allocations = 0;
+
+// counts C++ and Lua allocations made while in scope
+class AllocationCounter
+{
+public:
+    AllocationCounter(lua_State* L) : L(L)
+    {
+        f = lua_getallocf(L, &ud);
+        lua_setallocf(L, alloc, this);
+
+        cxx_allocations = 0;
+        counting = true;
+    }
+
+    ~AllocationCounter()
+    { stop(); }
+
+    // call before asserting, the test framework allocates too
+    void stop()
+    {
+        if ( !L )
+            return;
+
+        counting = false;
+        cxx_count = cxx_allocations;
+        lua_setallocf(L, f, ud);
+        L = nullptr;
+    }
+
+    size_t cxx() const
+    { return cxx_count; }
+
+    size_t lua() const
+    { return lua_count; }
+
+private:
+    // forwards to the original allocator, which LuaJIT may depend on
+    static void* alloc(void* ud, void* ptr, size_t osize, size_t nsize)
+    {
+        auto self = static_cast<AllocationCounter*>(ud);
+        if ( nsize > 0 )
+            ++self->lua_count;
+
+        return self->f(self->ud, ptr, osize, nsize);
+    }
+
+    lua_State* L;
+    lua_Alloc f;
+    void* ud;
+    size_t cxx_count = 0;
+    size_t lua_count = 0;
+};
+
+static int add(int a, int b)
+{ return a + b; }
+
+static double scale(double d, bool negate)
+{ return negate ? -d : d; }
+
+static int length(Lua::StringSpan s)
+{ return s.size(); }
+
+struct TUser
+{
+    int x = 2;
+
+    int mul(int y) const
+    { return x * y; }
+};
+
+// calls the function at index fn with an int and a bool
+static void call(lua_State* L, int fn)
+{
+    lua_pushvalue(L, fn);
+    lua_pushinteger(L, 3);
+    lua_pushboolean(L, true);
+    lua_call(L, 2, 1);
+}
+
+} // namespace t_allocations
+
+void* operator new(size_t n)
+{
+    if ( t_allocations::counting )
+        ++t_allocations::cxx_allocations;
+
+    if ( auto p = std::malloc(n ? n : 1) )
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t n)
+{ return operator new(n); }
+
+void operator delete(void* p) noexcept
+{ std::free(p); }
+
+void operator delete[](void* p) noexcept
+{ std::free(p); }
+
+// the nothrow forms too, so everything freed above came from malloc
+
+void* operator new(size_t n, const std::nothrow_t&) noexcept
+{
+    if ( t_allocations::counting )
+        ++t_allocations::cxx_allocations;
+
+    return std::malloc(n ? n : 1);
+}
+
+void* operator new[](size_t n, const std::nothrow_t& tag) noexcept
+{ return operator new(n, tag); }
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{ std::free(p); }
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{ std::free(p); }
+
+// -----------------------------------------------------------------------------
+// test cases
+// -----------------------------------------------------------------------------
+
+TEST_CASE( "allocation free calls" )
+{
+    using namespace Lua;
+    using namespace t_allocations;
+
+    State lua;
+
+    SECTION( "method pusher" )
+    {
+        detail::auto_pusher<decltype(&scale)>::push(lua, &scale);
+        auto fn = lua_gettop(lua);
+
+        // first call may grow the Lua stack
+        call(lua, fn);
+
+        AllocationCounter counter(lua);
+        call(lua, fn);
+        counter.stop();
+
+        CHECK( lua_tonumber(lua, -1) == -3 );
+        CHECK( counter.cxx() == 0 );
+        CHECK( counter.lua() == 0 );
+    }
+
+    SECTION( "capturing function object" )
+    {
+        // too big for std::function's small buffer, so copies allocate
+        int a = 1, b = 2, c = 3, d = 4, e = 5;
+        std::function<int(int, bool)> fn =
+            [a, b, c, d, e](int i, bool) { return i + a + b + c + d + e; };
+
+        detail::auto_pusher<decltype(fn)>::push(lua, fn);
+        auto f = lua_gettop(lua);
+        call(lua, f);
+
+        AllocationCounter counter(lua);
+        call(lua, f);
+        counter.stop();
+
+        CHECK( lua_tointeger(lua, -1) == 18 );
+        CHECK( counter.cxx() == 0 );
+        CHECK( counter.lua() == 0 );
+    }
+
+    SECTION( "function pusher" )
+    {
+        detail::function_pusher<decltype(&add), &add>::push(lua);
+        auto fn = lua_gettop(lua);
+
+        lua_pushvalue(lua, fn);
+        lua_pushinteger(lua, 1);
+        lua_pushinteger(lua, 2);
+        lua_call(lua, 2, 1);
+
+        AllocationCounter counter(lua);
+        lua_pushvalue(lua, fn);
+        lua_pushinteger(lua, 1);
+        lua_pushinteger(lua, 2);
+        lua_call(lua, 2, 1);
+        counter.stop();
+
+        CHECK( lua_tointeger(lua, -1) == 3 );
+        CHECK( counter.cxx() == 0 );
+        CHECK( counter.lua() == 0 );
+    }
+
+    SECTION( "string span argument" )
+    {
+        detail::function_pusher<decltype(&length), &length>::push(lua);
+        auto fn = lua_gettop(lua);
+
+        std::string line(4096, 'x');
+        lua_pushlstring(lua, line.data(), line.size());
+        auto s = lua_gettop(lua);
+
+        auto call_length = [&]
+        {
+            lua_pushvalue(lua, fn);
+            lua_pushvalue(lua, s);
+            lua_call(lua, 1, 1);
+        };
+
+        call_length();
+
+        AllocationCounter counter(lua);
+        call_length();
+        counter.stop();
+
+        CHECK( lua_tointeger(lua, -1) == 4096 );
+        CHECK( counter.cxx() == 0 );
+        CHECK( counter.lua() == 0 );
+    }
+
+    SECTION( "key lookup" )
+    {
+        static const Key first("allocations");
+
+        AllocationCounter counter(lua);
+        static const Key second("allocations");
+        counter.stop();
+
+        CHECK( second.index() == first.index() );
+        CHECK( counter.cxx() == 0 );
+    }
+
+    SECTION( "member function" )
+    {
+        registration::Editor<TUser>(lua, "TUser")
+            .add_method("mul", &TUser::mul)
+            .finish();
+
+        if ( luaL_dostring(lua, "u = TUser.new() return u.mul") )
+            FAIL( lua_tostring(lua, -1) );
+
+        auto fn = lua_gettop(lua);
+        lua_getglobal(lua, "u");
+        auto u = lua_gettop(lua);
+
+        auto call_mul = [&]
+        {
+            lua_pushvalue(lua, fn);
+            lua_pushvalue(lua, u);
+            lua_pushinteger(lua, 4);
+            lua_call(lua, 2, 1);
+        };
+
+        call_mul();
+
+        AllocationCounter counter(lua);
+        call_mul();
+        counter.stop();
+
+        CHECK( lua_tointeger(lua, -1) == 8 );
+        CHECK( counter.cxx() == 0 );
+        CHECK( counter.lua() == 0 );
+    }
+}
@@ -0,0 +1,21 @@
+// built with LUA_SHIM_STRICT_USER_ARGS and POLICY set to a policy; must
+// fail to compile, since the bound function takes a user object by value
+
+#include "functional_pushers.h"
+
+namespace
+{
+
+struct TUser
+{ int x = 0; };
+
+int by_value(TUser u)
+{ return u.x; }
+
+} // namespace
+
+void push_by_value(lua_State* L)
+{
+    Lua::detail::function_pusher<decltype(&by_value), &by_value>::
+        push<Lua::policy::POLICY>(L);
+}
@@ -0,0 +1,154 @@
+#include "type_registration.h"
+
+#include "common.h"
+
+namespace t_functional_overloads
+{
+// -----------------------------------------------------------------------------
+// fixtures
+// -----------------------------------------------------------------------------
+
+static int nullary()
+{ return 0; }
+
+static int unary(int)
+{ return 1; }
+
+static int with_string(int, std::string)
+{ return 2; }
+
+static int with_bool(int, bool)
+{ return 3; }
+
+struct TOther { };
+
+struct TUser
+{
+    int x = 0;
+    int y = 0;
+
+    TUser() { }
+    TUser(int x) : x(x) { }
+    TUser(int x, int y) : x(x), y(y) { }
+
+    int get() const
+    { return x; }
+
+    int set(int v)
+    { x = v; return x; }
+
+    int combine(TUser& o)
+    { return x + o.x; }
+
+    int combine(TOther&)
+    { return -1; }
+};
+
+static int call(lua_State* L, const char* code)
+{
+    if ( luaL_dostring(L, code) )
+        FAIL( lua_tostring(L, -1) );
+
+    return lua_tointeger(L, -1);
+}
+
+} // namespace t_functional_overloads
+
+// -----------------------------------------------------------------------------
+// test cases
+// -----------------------------------------------------------------------------
+
+TEST_CASE( "overloads" )
+{
+    using namespace Lua;
+    using namespace t_functional_overloads;
+
+    State lua;
+
+    SECTION( "free functions" )
+    {
+        detail::overload_pusher<decltype(&nullary), decltype(&unary),
+            decltype(&with_string), decltype(&with_bool)>::
+            push(lua, &nullary, &unary, &with_string, &with_bool);
+
+        lua_setglobal(lua, "f");
+
+        SECTION( "by arity" )
+        {
+            CHECK( call(lua, "return f()") == 0 );
+            CHECK( call(lua, "return f(1)") == 1 );
+        }
+
+        SECTION( "by argument type" )
+        {
+            CHECK( call(lua, "return f(1, 'a')") == 2 );
+            CHECK( call(lua, "return f(1, true)") == 3 );
+        }
+
+        SECTION( "extra arguments" )
+        {
+            // ignored, like a single binding ignores them
+            CHECK( call(lua, "return f(1, 'a', 3)") == 2 );
+            CHECK( call(lua, "return f(1, true, 3, 4)") == 3 );
+        }
+
+        SECTION( "no matching type" )
+        {
+            // falls through to the last candidate, which reports the error
+            REQUIRE( luaL_dostring(lua, "return f('a')") );
+
+            std::string e = lua_tostring(lua, -1);
+            CHECK( e == "TypeError: (arg #1) expected 'integer', got 'string'" );
+        }
+    }
+
+    SECTION( "methods" )
+    {
+        registration::Editor<TOther>(lua, "TOther").finish();
+
+        int(TUser::*combine_user)(TUser&) = &TUser::combine;
+        int(TUser::*combine_other)(TOther&) = &TUser::combine;
+
+        registration::Editor<TUser>(lua, "TUser")
+            .add_method("x", &TUser::get, &TUser::set)
+            .add_method("combine", combine_user, combine_other)
+            .add_ctors<void(), void(int), void(int, int)>()
+            .finish();
+
+        CHECK( util::find_type<TUser>(lua)->method_count == 2 );
+
+        SECTION( "getter and setter" )
+        {
+            CHECK( call(lua, "u = TUser.new(4) return u:x()") == 4 );
+            CHECK( call(lua, "return u:x(7)") == 7 );
+            CHECK( call(lua, "return u:x()") == 7 );
+        }
+
+        SECTION( "no matching arity" )
+        {
+            REQUIRE( luaL_dostring(lua, "return TUser.x()") );
+
+            std::string e = lua_tostring(lua, -1);
+            CHECK( e == "ArityError: no overload takes 0 arguments" );
+        }
+
+        SECTION( "by user type" )
+        {
+            CHECK( call(lua, "return TUser.new(1):combine(TUser.new(2))") == 3 );
+            CHECK( call(lua, "return TUser.new(1):combine(TOther.new())") == -1 );
+        }
+
+        SECTION( "constructors" )
+        {
+            CHECK( call(lua, "return TUser.new():x()") == 0 );
+            CHECK( call(lua, "return TUser.new(5):x()") == 5 );
+
+            call(lua, "u = TUser.new(5, 6)");
+            lua_getglobal(lua, "u");
+
+            auto& u = stack::cast<TUser&>(lua, -1);
+            CHECK( u.x == 5 );
+            CHECK( u.y == 6 );
+        }
+    }
+}
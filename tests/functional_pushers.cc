@@ -49,6 +49,88 @@ struct X
 
 int X::destructor_calls = 0;
 
+struct Buffer
+{
+    static int copies;
+    static int moves;
+
+    char data[256];
+
+    Buffer() { }
+    Buffer(const Buffer&) { ++copies; }
+    Buffer(Buffer&&) { ++moves; }
+};
+
+int Buffer::copies = 0;
+int Buffer::moves = 0;
+
+static const Buffer* buffer_spy = nullptr;
+
+static void buffer_ref(Buffer& b)
+{ buffer_spy = &b; }
+
+static void buffer_const_ref(const Buffer& b)
+{ buffer_spy = &b; }
+
+static void buffer_value(Buffer b)
+{ buffer_spy = &b; }
+
+static Buffer make_buffer()
+{ return Buffer(); }
+
+static Buffer* buffer_pointer()
+{ return const_cast<Buffer*>(buffer_spy); }
+
+static std::tuple<int, std::string, bool> tuple_function(int i)
+{ return std::make_tuple(i, "two", true); }
+
+static std::pair<double, int> pair_function()
+{ return { 1.5, 2 }; }
+
+static std::tuple<Buffer, int> buffer_tuple()
+{ return std::make_tuple(Buffer(), 3); }
+
+// more results than a C function is guaranteed stack for
+static std::tuple<int, int, int, int, int, int, int, int, int, int, int, int,
+    int, int, int, int, int, int, int, int, int, int, int, int> many_results()
+{ return std::make_tuple(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+    13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24); }
+
+// nested deeper than a C function is guaranteed stack for
+template<int N>
+struct nested
+{ using type = std::vector<typename nested<N - 1>::type>; };
+
+template<>
+struct nested<0>
+{ using type = int; };
+
+using Deep = nested<12>::type;
+
+template<int N>
+static typename nested<N>::type make_nested()
+{ return { make_nested<N - 1>() }; }
+
+template<>
+int make_nested<0>()
+{ return 7; }
+
+static Deep deep_result()
+{ return make_nested<12>(); }
+
+// containers arrive as tables and are returned as tables
+static std::vector<double> scaled(const std::vector<double>& v, double k)
+{
+    std::vector<double> r;
+    for ( auto x : v )
+        r.push_back(x * k);
+
+    return r;
+}
+
+static int length_of(const std::string& s)
+{ return s.size(); }
+
 } // namespace t_functor_pushers
 
 // -----------------------------------------------------------------------------
@@ -60,8 +142,8 @@ TEST_CASE ( "pushers" )
     using namespace t_functional_pushers;
     State lua;
 
-    Lua::traits::type_name_storage<X>::value = "X";
     luaL_newmetatable(lua, "X");
+    Lua::util::TypeRegistry::open(lua).add<X>(lua, "X", -1);
     lua_pop(lua, 1);
 
     SECTION( "auto pusher" )
@@ -116,12 +198,28 @@ TEST_CASE ( "pushers" )
                 REQUIRE( lua_type(lua, -1) == LUA_TFUNCTION );
 
                 lua_pushinteger(lua, 4);
+                lua_pushinteger(lua, 5);
 
-                if ( !lua_pcall(lua, 1, 0, 0) )
+                if ( !lua_pcall(lua, 2, 0, 0) )
                     FAIL( "expected a TypeError" );
 
                 std::string e = lua_tostring(lua, -1);
-                CHECK( e == "TypeError: (arg #2) expected 'boolean', got 'no value'" );
+                CHECK( e == "TypeError: (arg #2) expected 'boolean', got 'number'" );
+            }
+
+            SECTION( "arity checked" )
+            {
+                using func_type = decltype(void_static_function);
+                Lua::detail::auto_pusher<func_type>::
+                    push(lua, void_static_function);
+
+                lua_pushinteger(lua, 4);
+
+                if ( !lua_pcall(lua, 1, 0, 0) )
+                    FAIL( "expected an ArityError" );
+
+                std::string e = lua_tostring(lua, -1);
+                CHECK( e == "ArityError: expected 2 arguments, got 1" );
             }
         }
 
@@ -252,6 +350,316 @@ TEST_CASE ( "pushers" )
         }
     }
 
+    SECTION( "function pusher" )
+    {
+        SECTION( "function pointer" )
+        {
+            using func_type = decltype(&int_static_function);
+            Lua::detail::function_pusher<func_type, &int_static_function>::
+                push(lua);
+
+            REQUIRE( lua_type(lua, -1) == LUA_TFUNCTION );
+            static_function_spy = false;
+
+            lua_pushinteger(lua, 4);
+            lua_pushboolean(lua, true);
+
+            if ( lua_pcall(lua, 2, 1, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            CHECK( static_function_spy );
+            REQUIRE( lua_type(lua, -1) == LUA_TNUMBER );
+            CHECK( lua_tointeger(lua, -1) == 4 );
+        }
+
+        SECTION( "member function" )
+        {
+            X x(0);
+            Lua::util::userdata<X>::push(lua, x);
+            auto u = lua_gettop(lua);
+            Lua::util::userdata<X>::assign_metatable(lua, u);
+
+            using func_type = decltype(&X::int_member_function);
+            Lua::detail::function_pusher<func_type, &X::int_member_function>::
+                push(lua);
+
+            lua_pushvalue(lua, u);
+            lua_pushinteger(lua, 4);
+            lua_pushboolean(lua, true);
+
+            if ( lua_pcall(lua, 3, 1, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            CHECK( x.member_function_spy );
+            CHECK( lua_tointeger(lua, -1) == 4 );
+        }
+
+        SECTION( "const member function" )
+        {
+            X x(0);
+            Lua::util::userdata<X>::push(lua, x);
+            auto u = lua_gettop(lua);
+            Lua::util::userdata<X>::assign_metatable(lua, u);
+
+            using func_type = decltype(&X::const_member_function);
+            Lua::detail::function_pusher<func_type, &X::const_member_function>::
+                push(lua);
+
+            lua_pushvalue(lua, u);
+
+            if ( lua_pcall(lua, 1, 0, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            CHECK( x.const_member_function_spy );
+        }
+
+        SECTION( "exception handled" )
+        {
+            using func_type = decltype(&void_static_function);
+            Lua::detail::function_pusher<func_type, &void_static_function>::
+                push(lua);
+
+            lua_pushinteger(lua, 4);
+
+            if ( !lua_pcall(lua, 1, 0, 0) )
+                FAIL( "expected an ArityError" );
+
+            std::string e = lua_tostring(lua, -1);
+            CHECK( e == "ArityError: expected 2 arguments, got 1" );
+        }
+
+        SECTION( "extra arguments ignored" )
+        {
+            using func_type = decltype(&int_static_function);
+            Lua::detail::function_pusher<func_type, &int_static_function>::
+                push(lua);
+
+            lua_pushinteger(lua, 4);
+            lua_pushboolean(lua, true);
+            lua_pushnil(lua);
+
+            if ( lua_pcall(lua, 3, 1, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            CHECK( lua_tointeger(lua, -1) == 4 );
+        }
+    }
+
+    SECTION( "user arguments" )
+    {
+        luaL_newmetatable(lua, "Buffer");
+        Lua::util::TypeRegistry::open(lua).add<Buffer>(lua, "Buffer", -1);
+        lua_pop(lua, 1);
+
+        auto b = Lua::util::userdata<Buffer>::emplace(lua);
+        Lua::util::userdata<Buffer>::assign_metatable(lua, -1);
+        auto u = lua_gettop(lua);
+
+        Buffer::copies = 0;
+        Buffer::moves = 0;
+        buffer_spy = nullptr;
+
+        SECTION( "by reference" )
+        {
+            Lua::detail::auto_pusher<decltype(&buffer_ref)>::
+                push(lua, &buffer_ref);
+
+            lua_pushvalue(lua, u);
+            if ( lua_pcall(lua, 1, 0, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            CHECK( buffer_spy == b );
+            CHECK( Buffer::copies == 0 );
+            CHECK( Buffer::moves == 0 );
+        }
+
+        SECTION( "by const reference" )
+        {
+            Lua::detail::function_pusher<decltype(&buffer_const_ref),
+                &buffer_const_ref>::push(lua);
+
+            lua_pushvalue(lua, u);
+            if ( lua_pcall(lua, 1, 0, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            CHECK( buffer_spy == b );
+            CHECK( Buffer::copies == 0 );
+            CHECK( Buffer::moves == 0 );
+        }
+
+        SECTION( "by value" )
+        {
+            Lua::detail::function_pusher<decltype(&buffer_value),
+                &buffer_value>::push(lua);
+
+            lua_pushvalue(lua, u);
+            if ( lua_pcall(lua, 1, 0, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            CHECK( buffer_spy != b );
+            CHECK( Buffer::copies == 1 );
+        }
+
+        SECTION( "returned by value" )
+        {
+            Lua::detail::function_pusher<decltype(&make_buffer),
+                &make_buffer>::push(lua);
+
+            if ( lua_pcall(lua, 0, 1, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            CHECK( Lua::stack::is<Buffer>(lua, -1) );
+            CHECK( Lua::util::userdata<Buffer>::is_inline(lua, -1) );
+            CHECK( Buffer::copies == 0 );
+            CHECK( Buffer::moves == 1 );
+        }
+
+        SECTION( "returned by pointer" )
+        {
+            buffer_spy = b;
+
+            Lua::detail::auto_pusher<decltype(&buffer_pointer)>::
+                push(lua, &buffer_pointer);
+
+            if ( lua_pcall(lua, 0, 1, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            CHECK( Lua::stack::is<Buffer>(lua, -1) );
+            CHECK_FALSE( Lua::util::userdata<Buffer>::is_inline(lua, -1) );
+            CHECK( &Lua::stack::cast<Buffer&>(lua, -1) == b );
+
+            buffer_spy = nullptr;
+            Lua::detail::auto_pusher<decltype(&buffer_pointer)>::
+                push(lua, &buffer_pointer);
+
+            if ( lua_pcall(lua, 0, 1, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            CHECK( lua_isnil(lua, -1) );
+        }
+    }
+
+    SECTION( "multiple returns" )
+    {
+        SECTION( "tuple" )
+        {
+            Lua::detail::function_pusher<decltype(&tuple_function),
+                &tuple_function>::push(lua);
+
+            lua_pushinteger(lua, 1);
+            if ( lua_pcall(lua, 1, LUA_MULTRET, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            REQUIRE( lua_gettop(lua) == 3 );
+            CHECK( lua_tointeger(lua, 1) == 1 );
+            CHECK( std::string(lua_tostring(lua, 2)) == "two" );
+            CHECK( lua_toboolean(lua, 3) );
+        }
+
+        SECTION( "pair" )
+        {
+            Lua::detail::auto_pusher<decltype(&pair_function)>::
+                push(lua, &pair_function);
+
+            if ( lua_pcall(lua, 0, LUA_MULTRET, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            REQUIRE( lua_gettop(lua) == 2 );
+            CHECK( lua_tonumber(lua, 1) == 1.5 );
+            CHECK( lua_tointeger(lua, 2) == 2 );
+        }
+
+        SECTION( "stack reserved" )
+        {
+            Lua::detail::function_pusher<decltype(&many_results),
+                &many_results>::push(lua);
+
+            if ( lua_pcall(lua, 0, LUA_MULTRET, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            REQUIRE( lua_gettop(lua) == 24 );
+            CHECK( lua_tointeger(lua, 1) == 1 );
+            CHECK( lua_tointeger(lua, 24) == 24 );
+        }
+
+        SECTION( "nested containers" )
+        {
+            Lua::detail::function_pusher<decltype(&deep_result),
+                &deep_result>::push(lua);
+            lua_setglobal(lua, "deep");
+
+            if ( luaL_dostring(lua,
+                "local t, depth = deep(), 0\n"
+                "while type(t) == 'table' do t = t[1]; depth = depth + 1 end\n"
+                "return depth, t") )
+                FAIL( lua_tostring(lua, -1) );
+
+            CHECK( lua_tointeger(lua, -2) == 12 );
+            CHECK( lua_tointeger(lua, -1) == 7 );
+
+            // and read back
+            Lua::stack::push(lua, deep_result());
+            CHECK( Lua::stack::getx<Deep>(lua, -1) == deep_result() );
+        }
+
+        SECTION( "user element" )
+        {
+            luaL_newmetatable(lua, "Buffer");
+            Lua::util::TypeRegistry::open(lua).add<Buffer>(lua, "Buffer", -1);
+            lua_pop(lua, 1);
+
+            Lua::detail::function_pusher<decltype(&buffer_tuple),
+                &buffer_tuple>::push(lua);
+
+            Buffer::copies = 0;
+            if ( lua_pcall(lua, 0, LUA_MULTRET, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            REQUIRE( lua_gettop(lua) == 2 );
+            CHECK( Lua::stack::is<Buffer>(lua, 1) );
+            CHECK( lua_tointeger(lua, 2) == 3 );
+            CHECK( Buffer::copies == 0 );
+        }
+    }
+
+    SECTION( "const reference arguments" )
+    {
+        SECTION( "container" )
+        {
+            Lua::detail::function_pusher<decltype(&scaled), &scaled>::push(lua);
+
+            Lua::stack::push(lua, std::vector<double> { 1, 2 });
+            lua_pushnumber(lua, 0.5);
+            if ( lua_pcall(lua, 2, 1, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            CHECK( Lua::stack::getx<std::vector<double>>(lua, -1) ==
+                std::vector<double>({ 0.5, 1 }) );
+        }
+
+        SECTION( "string" )
+        {
+            Lua::detail::function_pusher<decltype(&length_of), &length_of>::push(lua);
+
+            lua_pushliteral(lua, "four");
+            if ( lua_pcall(lua, 1, 1, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            CHECK( lua_tointeger(lua, -1) == 4 );
+        }
+
+        SECTION( "wrong element" )
+        {
+            Lua::detail::function_pusher<decltype(&scaled), &scaled>::push(lua);
+
+            Lua::stack::push(lua, std::vector<std::string> { "x" });
+            lua_pushnumber(lua, 0.5);
+            REQUIRE( lua_pcall(lua, 2, 1, 0) );
+            CHECK( std::string(lua_tostring(lua, -1)) ==
+                "TypeError: (arg #1) expected 'table of number', got 'table'" );
+        }
+    }
+
     SECTION( "constructor pusher" )
     {
         Lua::detail::constructor_pusher<X, int>::push(lua);
@@ -270,18 +678,36 @@ TEST_CASE ( "pushers" )
             REQUIRE( *h );
             auto p = *h;
 
+            // constructed inline, in the same block
+            CHECK( static_cast<void*>(p) ==
+                Lua::util::userdata<X>::storage(h) );
+
             CHECK( p->constructor_called );
             CHECK( p->constructor_init == v );
-            delete p;
+
+            X::destructor_calls = 0;
+            Lua::util::userdata<X>::destroy(lua, -1);
+            CHECK( X::destructor_calls == 1 );
         }
 
         SECTION( "handles exception" )
         {
-            if ( !lua_pcall(lua, 0, 1, 0) )
+            lua_pushboolean(lua, true);
+
+            if ( !lua_pcall(lua, 1, 1, 0) )
                 FAIL( "expected a TypeError" );
 
             std::string e = lua_tostring(lua, -1);
-            CHECK( e == "TypeError: (arg #1) expected 'integer', got 'no value'" );
+            CHECK( e == "TypeError: (arg #1) expected 'integer', got 'boolean'" );
+        }
+
+        SECTION( "arity checked" )
+        {
+            if ( !lua_pcall(lua, 0, 1, 0) )
+                FAIL( "expected an ArityError" );
+
+            std::string e = lua_tostring(lua, -1);
+            CHECK( e == "ArityError: expected 1 argument, got 0" );
         }
     }
 
@@ -293,27 +719,40 @@ TEST_CASE ( "pushers" )
         SECTION( "normal operation" )
         {
             X::destructor_calls = 0;
-            auto h = static_cast<X**>(lua_newuserdata(lua, sizeof(X*)));
+            Lua::util::userdata<X>::emplace(lua, 0);
+            auto h = static_cast<X**>(lua_touserdata(lua, -1));
             REQUIRE( h );
-            *h = new X(0);
+            REQUIRE( *h );
 
             // FIXIT-H cryptic TypeError error message when metatable is not assigned
             luaL_getmetatable(lua, "X");
             lua_setmetatable(lua, -2);
 
             if ( lua_pcall(lua, 1, 0, 0) )
-            {
-                // make sure to cleanup
-                if ( *h )
-                    delete *h;
-
                 FAIL( lua_tostring(lua, -1) );
-            }
 
             CHECK( X::destructor_calls == 1 );
             CHECK_FALSE( *h );
         }
 
+        SECTION( "non-owning pointer" )
+        {
+            X x(0);
+            X::destructor_calls = 0;
+            Lua::util::userdata<X>::push(lua, x);
+            auto h = static_cast<X**>(lua_touserdata(lua, -1));
+            REQUIRE( h );
+
+            luaL_getmetatable(lua, "X");
+            lua_setmetatable(lua, -2);
+
+            if ( lua_pcall(lua, 1, 0, 0) )
+                FAIL( lua_tostring(lua, -1) );
+
+            CHECK( X::destructor_calls == 0 );
+            CHECK_FALSE( *h );
+        }
+
         SECTION( "handles exception" )
         {
             if ( !lua_pcall(lua, 0, 0, 0) )
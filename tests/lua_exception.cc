@@ -0,0 +1,65 @@
+#include <stdexcept>
+
+#include "lua_exception.h"
+#include "common.h"
+
+namespace t_lua_exception
+{
+// -----------------------------------------------------------------------------
+// fixtures
+// -----------------------------------------------------------------------------
+
+static int throws_std(lua_State*)
+{ throw std::runtime_error("std error"); }
+
+static int throws_type_error(lua_State*)
+{ throw Lua::TypeError(1, "integer", "nil"); }
+
+static int throws_c_string(lua_State*)
+{ throw "c string"; }
+
+static int raises_lua_error(lua_State* L)
+{ return luaL_error(L, "lua error"); }
+
+static int returns(lua_State* L)
+{
+    lua_pushinteger(L, 42);
+    return 1;
+}
+
+static std::string pcall(lua_State* L, lua_CFunction f)
+{
+    lua_pushcfunction(L, f);
+    if ( !lua_pcall(L, 0, 1, 0) )
+        return "no error";
+
+    std::string e = lua_tostring(L, -1);
+    lua_pop(L, 1);
+    return e;
+}
+
+} // namespace t_lua_exception
+
+// -----------------------------------------------------------------------------
+// test cases
+// -----------------------------------------------------------------------------
+
+TEST_CASE( "exception boundary" )
+{
+    using namespace t_lua_exception;
+
+    State lua;
+
+    REQUIRE( Lua::set_exception_boundary(lua) );
+
+    CHECK( pcall(lua, throws_std) == "std error" );
+    CHECK( pcall(lua, throws_c_string) == "c string" );
+    CHECK( pcall(lua, throws_type_error) ==
+        "TypeError: (arg #1) expected 'integer', got 'nil'" );
+
+    // Lua errors pass through untouched
+    CHECK( pcall(lua, raises_lua_error) == "lua error" );
+
+    CHECK( pcall(lua, returns) == "no error" );
+    CHECK( lua_tointeger(lua, -1) == 42 );
+}
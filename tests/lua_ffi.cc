@@ -0,0 +1,140 @@
+#include "type_registration.h"
+#include "common.h"
+
+namespace t_lua_ffi
+{
+// -----------------------------------------------------------------------------
+// fixtures
+// -----------------------------------------------------------------------------
+
+enum class Small : char { A = 1 };
+
+struct TUser
+{
+    int x = 0;
+
+    TUser() { }
+    TUser(int y) : x(y) { }
+
+    int add(int a) const { return x + a; }
+    void set(double v) { x = v; }
+
+    static double half(double v) noexcept { return v / 2; }
+    static double twice(double v) { return v * 2; }
+    static int length(const char* s) { return std::string(s).size(); }
+    static std::string name() { return "user"; }
+};
+
+struct TOther { };
+
+template<typename F, F fn>
+static std::string signature()
+{ return Lua::detail::ffi_trampoline<F, fn>::signature(); }
+
+static void run(lua_State* L, const char* code)
+{
+    if ( luaL_dostring(L, code) )
+        FAIL( lua_tostring(L, -1) );
+}
+
+} // namespace t_lua_ffi
+
+// -----------------------------------------------------------------------------
+// test cases
+// -----------------------------------------------------------------------------
+
+TEST_CASE( "ffi exports" )
+{
+    using namespace Lua;
+    using namespace t_lua_ffi;
+
+    SECTION( "declarations" )
+    {
+        CHECK( util::ctype<Small>::name() == "int8_t" );
+        CHECK( util::ctype<unsigned short>::name() == "uint16_t" );
+
+        CHECK( (signature<decltype(&TUser::half), &TUser::half>()) ==
+            "double (*)(double)" );
+
+        CHECK( (detail::ffi_trampoline<decltype(&TUser::half), &TUser::half>::nothrow) );
+        CHECK_FALSE( (detail::ffi_trampoline<decltype(&TUser::twice), &TUser::twice>::nothrow) );
+
+        // methods, strings and other objects stay on the checked path
+        CHECK_FALSE( (detail::ffi_trampoline<decltype(&TUser::set), &TUser::set>::exportable) );
+        CHECK_FALSE( (detail::ffi_trampoline<decltype(&TUser::length), &TUser::length>::exportable) );
+        CHECK_FALSE( (detail::ffi_trampoline<decltype(&TUser::name), &TUser::name>::exportable) );
+    }
+
+    SECTION( "bound class" )
+    {
+        State lua;
+
+        registration::Editor<TUser, policy::ffi>(lua, "TUser")
+            .add_method<decltype(&TUser::add), &TUser::add>("add")
+            .add_method<decltype(&TUser::set), &TUser::set>("set")
+            .add_method<decltype(&TUser::half), &TUser::half>("half")
+            .add_method<decltype(&TUser::length), &TUser::length>("length")
+            .add_method<decltype(&TUser::name), &TUser::name>("name")
+            .add_ctor<int>();
+
+        run(lua, "return type(TUser.half), type(TUser.add), type(TUser.length)");
+        CHECK( std::string(lua_tostring(lua, -3)) == "cdata" );
+        CHECK( std::string(lua_tostring(lua, -2)) == "function" );
+        CHECK( std::string(lua_tostring(lua, -1)) == "function" );
+
+        run(lua,
+            "local u = TUser.new(1)\n"
+            "local sum = 0\n"
+            "for i = 1, 1000 do sum = sum + u:add(i) end\n"
+            "u:set(7)\n"
+            "return sum, u:add(0), TUser.half(3), TUser.length('abc'),\n"
+            "    TUser.name()");
+
+        CHECK( lua_tointeger(lua, -5) == 501500 );
+        CHECK( lua_tointeger(lua, -4) == 7 );
+        CHECK( lua_tonumber(lua, -3) == 1.5 );
+        CHECK( lua_tointeger(lua, -2) == 3 );
+        CHECK( std::string(lua_tostring(lua, -1)) == "user" );
+
+        // the FFI checks the arguments
+        REQUIRE( luaL_dostring(lua, "return TUser.half('x')") );
+
+        auto error = [&](const char* code) -> std::string
+        {
+            if ( !luaL_dostring(lua, code) )
+                return "no error";
+
+            return lua_tostring(lua, -1);
+        };
+
+        // and the shim still checks self, and strings
+        registration::Editor<TOther>(lua, "TOther").finish();
+
+        CHECK( error("return TUser.add(nil, 2)") ==
+            "TypeError: (arg #1) expected 'TUser', got 'nil'" );
+        CHECK( error("return TUser.add(TOther.new(), 2)") ==
+            "TypeError: (arg #1) expected 'TUser', got 'userdata'" );
+        CHECK( error("return TUser.length(nil)") ==
+            "TypeError: (arg #1) expected 'string', got 'nil'" );
+        CHECK( error(
+            "local u = TUser.new(1)\n"
+            "debug.getmetatable(u).__gc(u)\n"
+            "return u:add(2)") ==
+            "TypeError: (arg #1) expected 'TUser', got 'userdata'" );
+    }
+
+    SECTION( "without the ffi" )
+    {
+        auto L = luaL_newstate();
+
+        registration::Editor<TUser, policy::ffi>(L, "TUser")
+            .add_method<decltype(&TUser::add), &TUser::add>("add")
+            .finish();
+
+        lua_getglobal(L, "TUser");
+        lua_getfield(L, -1, "add");
+        CHECK( lua_iscfunction(L, -1) );
+
+        lua_close(L);
+    }
+}
@@ -41,3 +41,25 @@ TEST_CASE( "gc object" )
 
     CHECK( TUser::destructor_called );
 }
+
+TEST_CASE( "gc object metatable" )
+{
+    using namespace t_lua_gcobject;
+
+    State lua;
+
+    TUser u(1);
+    Lua::util::gc_object::push(lua, u);
+    Lua::util::gc_object::push(lua, u);
+
+    int i = 2;
+    Lua::util::gc_object::push(lua, i);
+
+    REQUIRE( lua_getmetatable(lua, -3) );
+    REQUIRE( lua_getmetatable(lua, -3) );
+    REQUIRE( lua_getmetatable(lua, -3) );
+
+    // shared between objects of the same type
+    CHECK( lua_rawequal(lua, -3, -2) );
+    CHECK_FALSE( lua_rawequal(lua, -2, -1) );
+}
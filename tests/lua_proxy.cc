@@ -0,0 +1,142 @@
+#include "type_registration.h"
+#include "common.h"
+
+namespace t_lua_proxy
+{
+// -----------------------------------------------------------------------------
+// fixtures
+// -----------------------------------------------------------------------------
+
+struct Point
+{
+    int x = 0;
+
+    Point() { }
+    Point(int x) : x(x) { }
+};
+
+static void run(lua_State* L, const char* code)
+{
+    if ( luaL_dostring(L, code) )
+        FAIL( lua_tostring(L, -1) );
+}
+
+static std::string error(lua_State* L, const char* code)
+{
+    if ( !luaL_dostring(L, code) )
+        return "no error";
+
+    return lua_tostring(L, -1);
+}
+
+} // namespace t_lua_proxy
+
+// -----------------------------------------------------------------------------
+// test cases
+// -----------------------------------------------------------------------------
+
+TEST_CASE( "container proxy" )
+{
+    using namespace Lua;
+    using namespace t_lua_proxy;
+
+    State lua;
+
+    SECTION( "vector" )
+    {
+        std::vector<double> v { 1.5, 2.5 };
+        util::container_proxy<std::vector<double>>::push(lua, v);
+        lua_setglobal(lua, "v");
+
+        run(lua, "return #v, v[2], v[3], v.size");
+        CHECK( lua_tointeger(lua, -4) == 2 );
+        CHECK( lua_tonumber(lua, -3) == 2.5 );
+        CHECK( lua_isnil(lua, -2) );
+        CHECK( lua_isnil(lua, -1) );
+
+        run(lua, "v[1] = 4; v[3] = 5");
+        CHECK( v == std::vector<double>({ 4, 2.5, 5 }) );
+
+        CHECK( error(lua, "v[5] = 1") ==
+            "[string \"v[5] = 1\"]:1: index 5 out of range" );
+        CHECK( error(lua, "v[1] = 'x'") ==
+            "TypeError: (arg #3) expected 'number', got 'string'" );
+
+        // the metatable is hidden and shared
+        run(lua, "return getmetatable(v)");
+        CHECK( lua_toboolean(lua, -1) == 0 );
+        CHECK( v.size() == 3 );
+    }
+
+    SECTION( "deque" )
+    {
+        std::deque<bool> d { true };
+        util::container_proxy<std::deque<bool>>::push(lua, d);
+        lua_setglobal(lua, "d");
+
+        run(lua, "d[2] = false; return d[1], #d");
+        CHECK( lua_toboolean(lua, -2) );
+        CHECK( lua_tointeger(lua, -1) == 2 );
+        CHECK( d.size() == 2 );
+    }
+
+    SECTION( "unordered map" )
+    {
+        std::unordered_map<std::string, int> m { { "a", 1 } };
+        util::container_proxy<std::unordered_map<std::string, int>>::push(lua, m);
+        lua_setglobal(lua, "m");
+
+        run(lua, "m.b = 2; m.a = nil; return m.b, m.a, m[1], #m");
+        CHECK( lua_tointeger(lua, -4) == 2 );
+        CHECK( lua_isnil(lua, -3) );
+        CHECK( lua_isnil(lua, -2) );
+        CHECK( lua_tointeger(lua, -1) == 1 );
+
+        CHECK( m.count("a") == 0 );
+        CHECK( m.at("b") == 2 );
+    }
+
+    SECTION( "user elements by value" )
+    {
+        registration::Editor<Point>(lua, "Point")
+            .add_ctor<int>()
+            .add_property("x", &Point::x);
+
+        std::vector<Point> v { Point(1), Point(2) };
+        util::container_proxy<std::vector<Point>>::push(lua, v);
+        lua_setglobal(lua, "v");
+
+        run(lua, "v[3] = Point.new(3); return v[2]");
+        CHECK( &stack::getx<Point&>(lua, -1) != &v[1] );
+
+        REQUIRE( v.size() == 3 );
+        CHECK( v[2].x == 3 );
+
+        // a copy outlives reallocation, and is written back by assigning it
+        run(lua,
+            "local p = v[1]\n"
+            "for i = 1, 100 do v[#v + 1] = Point.new(i) end\n"
+            "p.x = 9\n"
+            "v[2] = p");
+
+        CHECK( v[0].x == 1 );
+        CHECK( v[1].x == 9 );
+    }
+
+    SECTION( "checks what it's called on" )
+    {
+        std::vector<int> v { 1 };
+        util::container_proxy<std::vector<int>>::push(lua, v);
+        lua_setglobal(lua, "v");
+
+        CHECK( error(lua, "return debug.getmetatable(v).__index(1, 1)").find(
+            "expected a container proxy, got 'number'") != std::string::npos );
+
+        std::vector<double> w;
+        util::container_proxy<std::vector<double>>::push(lua, w);
+        lua_setglobal(lua, "w");
+
+        CHECK( error(lua, "return debug.getmetatable(w).__len(v)").find(
+            "expected a container proxy, got 'userdata'") != std::string::npos );
+    }
+}
@@ -0,0 +1,100 @@
+#include "shim_dispatch.h"
+#include "common.h"
+
+namespace t_lua_string_cache
+{
+// -----------------------------------------------------------------------------
+// fixtures
+// -----------------------------------------------------------------------------
+
+static const Lua::Key field("field");
+static const Lua::Key other("other");
+
+} // namespace t_lua_string_cache
+
+// -----------------------------------------------------------------------------
+// test cases
+// -----------------------------------------------------------------------------
+
+TEST_CASE( "string cache" )
+{
+    using namespace Lua;
+    using namespace t_lua_string_cache;
+
+    State lua;
+
+    CHECK( field.index() != other.index() );
+    CHECK( field.size() == 5 );
+
+    auto& cache = StringCache::open(lua);
+    CHECK( &StringCache::open(lua) == &cache );
+
+    SECTION( "pinned once" )
+    {
+        cache.push(lua, field);
+        cache.push(lua, field);
+        cache.push(lua, other);
+
+        CHECK( cache.size() == 2 );
+
+        CHECK( std::string(lua_tostring(lua, -3)) == "field" );
+        CHECK( std::string(lua_tostring(lua, -1)) == "other" );
+
+        // the same interned string
+        CHECK( lua_tostring(lua, -3) == lua_tostring(lua, -2) );
+    }
+
+    SECTION( "stack push" )
+    {
+        stack::push(lua, field);
+        REQUIRE( lua_type(lua, -1) == LUA_TSTRING );
+        CHECK( std::string(lua_tostring(lua, -1)) == "field" );
+        CHECK( cache.size() == 1 );
+    }
+
+    SECTION( "embedded zeros" )
+    {
+        Key k("a\0b");
+        cache.push(lua, k);
+
+        size_t len;
+        auto s = lua_tolstring(lua, -1, &len);
+        CHECK( std::string(s, len) == std::string("a\0b", 3) );
+    }
+
+    SECTION( "bounded" )
+    {
+        // only literals make keys
+        CHECK_FALSE( (std::is_constructible<Key, const char*, size_t>::value) );
+        CHECK_FALSE( (std::is_constructible<Key, char (&)[4]>::value) );
+
+        // keys made over and over share one id and one pinned string
+        auto top = lua_gettop(lua);
+        for ( int i = 0; i < 1000; ++i )
+        {
+            Key k("dynamic");
+            cache.push(lua, k);
+            lua_settop(lua, top);
+        }
+
+        CHECK( cache.size() == 1 );
+        CHECK( Key("dynamic").index() == Key("dynamic").index() );
+
+        // so do keys with equal strings
+        static const char same[] = "field";
+        CHECK( Key(same).index() == field.index() );
+    }
+
+    SECTION( "per state" )
+    {
+        State other_state;
+        auto& other_cache = StringCache::open(other_state);
+        CHECK( &other_cache != &cache );
+
+        cache.push(lua, field);
+        other_cache.push(other_state, field);
+
+        CHECK( std::string(lua_tostring(other_state, -1)) == "field" );
+        CHECK( other_cache.size() == 1 );
+    }
+}
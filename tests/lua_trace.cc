@@ -0,0 +1,88 @@
+#include <cstdio>
+
+#include "lua_trace.h"
+#include "type_registration.h"
+#include "common.h"
+
+namespace t_lua_trace
+{
+// -----------------------------------------------------------------------------
+// fixtures
+// -----------------------------------------------------------------------------
+
+struct TUser
+{
+    int get() const { return 1; }
+};
+
+// a hot loop calling a bound method, which aborts its traces
+static const char hot_loop[] =
+    "local u = TUser.new()\n"
+    "local s = 0\n"
+    "for i = 1, 1000 do s = s + u:get() end\n"
+    "return s";
+
+static void run(lua_State* L, const char* code)
+{
+    if ( luaL_loadbuffer(L, code, std::strlen(code), "=hot") or
+        lua_pcall(L, 0, 0, 0) )
+        FAIL( lua_tostring(L, -1) );
+}
+
+} // namespace t_lua_trace
+
+// -----------------------------------------------------------------------------
+// test cases
+// -----------------------------------------------------------------------------
+
+TEST_CASE( "trace diagnostics" )
+{
+    using namespace Lua;
+    using namespace t_lua_trace;
+
+    State lua;
+
+    registration::Editor<TUser>(lua, "TUser")
+        .add_method("get", &TUser::get);
+
+    TraceDiagnostics diag;
+    REQUIRE( diag.attach(lua) );
+
+    SECTION( "named bindings" )
+    {
+        run(lua, hot_loop);
+
+        auto aborts = diag.ranked();
+        REQUIRE( !aborts.empty() );
+
+        CHECK( aborts[0].binding == "TUser:get" );
+        CHECK( aborts[0].location == "hot:3" );
+        CHECK( aborts[0].reason.find("TUser:get") != std::string::npos );
+        CHECK( aborts[0].count > 0 );
+
+        for ( size_t i = 1; i < aborts.size(); ++i )
+            CHECK( aborts[i - 1].count >= aborts[i].count );
+    }
+
+    SECTION( "report" )
+    {
+        run(lua, hot_loop);
+
+        auto f = std::tmpfile();
+        diag.report(f);
+
+        char buf[256] = {};
+        std::rewind(f);
+        CHECK( std::fgets(buf, sizeof(buf), f) );
+        CHECK( std::fgets(buf, sizeof(buf), f) );
+        CHECK( std::string(buf).find("TUser:get") != std::string::npos );
+        std::fclose(f);
+    }
+
+    SECTION( "detached" )
+    {
+        diag.detach();
+        run(lua, hot_loop);
+        CHECK( diag.ranked().empty() );
+    }
+}
@@ -15,11 +15,19 @@ namespace t_lua_userdata
 
 struct TUser
 {
+    static int destructor_calls;
+
     int v = d_v;
     TUser() { }
     TUser(int v) : v(v) { }
+    ~TUser() { ++destructor_calls; }
 };
 
+int TUser::destructor_calls = 0;
+
+struct alignas(32) TAligned
+{ char c = 'x'; };
+
 
 // -----------------------------------------------------------------------------
 // static asserts
@@ -81,17 +89,54 @@ TEST_CASE ( "userdata" )
 
     SECTION ( "emplace" )
     {
-        Lua::util::userdata<X>::emplace(lua);
+        Lua::util::userdata<X>::emplace(lua, 7);
         CHECK( lua_type(lua, -1) == LUA_TUSERDATA );
 
         auto h = static_cast<X**>(lua_touserdata(lua, -1));
         REQUIRE( h );
         REQUIRE( *h );
 
-        delete *h;
+        CHECK( static_cast<void*>(*h) == Lua::util::userdata<X>::storage(h) );
+        CHECK( (*h)->v == 7 );
+        CHECK( Lua::util::userdata<X>::is_inline(lua, -1) );
+
+        Lua::util::userdata<X>::destroy(lua, -1);
+    }
+
+    SECTION ( "emplace over-aligned" )
+    {
+        auto p = Lua::util::userdata<TAligned>::emplace(lua);
+        REQUIRE( p );
+
+        CHECK( reinterpret_cast<std::uintptr_t>(p) % alignof(TAligned) == 0 );
+        CHECK( p->c == 'x' );
     }
 
     SECTION ( "destroy" )
     {
+        SECTION ( "inline" )
+        {
+            Lua::util::userdata<X>::emplace(lua);
+            X::destructor_calls = 0;
+
+            Lua::util::userdata<X>::destroy(lua, -1);
+            CHECK( X::destructor_calls == 1 );
+            CHECK_FALSE( *Lua::util::userdata<X>::extract(lua, -1) );
+
+            // destroying twice is harmless
+            Lua::util::userdata<X>::destroy(lua, -1);
+            CHECK( X::destructor_calls == 1 );
+        }
+
+        SECTION ( "non-owning" )
+        {
+            Lua::util::userdata<X>::push(lua, *x);
+            CHECK_FALSE( Lua::util::userdata<X>::is_inline(lua, -1) );
+            X::destructor_calls = 0;
+
+            Lua::util::userdata<X>::destroy(lua, -1);
+            CHECK( X::destructor_calls == 0 );
+            CHECK_FALSE( *Lua::util::userdata<X>::extract(lua, -1) );
+        }
     }
 }
@@ -0,0 +1,71 @@
+#ifndef LUA_SHIM_NO_EXCEPTIONS
+#include <stdexcept>
+#endif
+
+#include "type_registration.h"
+#include "lua_exception.h"
+
+#include "bindings.h"
+
+namespace t_modes
+{
+// -----------------------------------------------------------------------------
+// fixtures
+// -----------------------------------------------------------------------------
+
+namespace
+{
+
+struct TUser
+{
+    int x = 0;
+
+    TUser() { }
+    TUser(int x) : x(x) { }
+
+    int get() const
+    { return x; }
+
+    int set(int v)
+    { x = v; return x; }
+};
+
+int add(int a, int b)
+{ return a + b; }
+
+#ifndef LUA_SHIM_NO_EXCEPTIONS
+void fail()
+{ throw std::runtime_error("failed"); }
+#endif
+
+template<typename F>
+void set_global(lua_State* L, const char* name, F fn)
+{
+    Lua::detail::auto_pusher<F>::push(L, fn);
+    lua_setglobal(L, name);
+}
+
+} // namespace
+
+void open_bindings(lua_State* L)
+{
+    using namespace Lua;
+
+#ifdef LUA_SHIM_LUAJIT_UNWIND
+    set_exception_boundary(L);
+#endif
+
+    set_global(L, "add", &add);
+
+#ifndef LUA_SHIM_NO_EXCEPTIONS
+    set_global(L, "fail", &fail);
+#endif
+
+    register_class<TUser>(L, "TUser")
+        .add_ctor<int>()
+        .add_method("get", &TUser::get)
+        .add_method("value", &TUser::get, &TUser::set)
+        .add_property("x", &TUser::x);
+}
+
+} // namespace t_modes
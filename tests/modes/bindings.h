@@ -0,0 +1,13 @@
+#pragma once
+
+struct lua_State;
+
+// the bindings exercised by modes.cc, compiled under the error handling
+// mode of the test executable
+
+namespace t_modes
+{
+
+void open_bindings(lua_State* L);
+
+} // namespace t_modes
@@ -0,0 +1,74 @@
+#include <string>
+
+#include "common.h"
+#include "bindings.h"
+
+// runs against the bindings as built under LUA_SHIM_NO_EXCEPTIONS or
+// LUA_SHIM_LUAJIT_UNWIND; the macros change inline function bodies, so
+// each mode has a test executable of its own
+
+namespace t_modes
+{
+// -----------------------------------------------------------------------------
+// fixtures
+// -----------------------------------------------------------------------------
+
+// the result of code as a string, or the error it raised
+static std::string run(lua_State* L, const char* code)
+{
+    if ( luaL_dostring(L, code) )
+        return lua_tostring(L, -1);
+
+    return lua_isnil(L, -1) ? "nil" : lua_tostring(L, -1);
+}
+
+} // namespace t_modes
+
+// -----------------------------------------------------------------------------
+// test cases
+// -----------------------------------------------------------------------------
+
+TEST_CASE( "error handling modes" )
+{
+    using namespace t_modes;
+
+    State lua;
+    open_bindings(lua);
+
+    SECTION( "calls" )
+    {
+        CHECK( run(lua, "return add(1, 2)") == "3" );
+        CHECK( run(lua, "return TUser.new(4):get()") == "4" );
+        CHECK( run(lua, "u = TUser.new(1); u.x = 5; return u.x") == "5" );
+        CHECK( run(lua, "return TUser.new(2):value(7)") == "7" );
+    }
+
+    SECTION( "type errors" )
+    {
+        CHECK( run(lua, "return add(1, 'a')") ==
+            "TypeError: (arg #2) expected 'integer', got 'string'" );
+
+        CHECK( run(lua, "return TUser.get(1)") ==
+            "TypeError: (arg #1) expected 'TUser', got 'number'" );
+
+        CHECK( run(lua, "TUser.new(1).x = 'a'") ==
+            "TypeError: (arg #3) expected 'integer', got 'string'" );
+
+        CHECK( run(lua, "return TUser.new(1):value('a')") ==
+            "TypeError: (arg #2) expected 'integer', got 'string'" );
+    }
+
+    SECTION( "protected calls keep working" )
+    {
+        CHECK( run(lua,
+            "local ok = pcall(add, 'a')\n"
+            "return tostring(ok) .. ' ' .. add(2, 3)") == "false 5" );
+    }
+
+#ifdef LUA_SHIM_LUAJIT_UNWIND
+    SECTION( "exceptions from bound code" )
+    {
+        CHECK( run(lua, "return fail()") == "failed" );
+    }
+#endif
+}
@@ -17,7 +17,7 @@ void integral_stack_test(lua_State* L, int type, T v, const char* name)
 {
     using namespace Lua;
 
-    CHECK( stack::type_name<T>() == name );
+    CHECK( std::string(stack::type_name<T>(L)) == name );
 
     stack::push(L, v);
     REQUIRE( lua_type(L, -1) == type );
@@ -30,7 +30,7 @@ void string_stack_test(lua_State* L, T v)
 {
     using namespace Lua;
 
-    CHECK( stack::type_name<T>() == "string" );
+    CHECK( std::string(stack::type_name<T>(L)) == "string" );
 
     stack::push(L, v);
     REQUIRE( lua_type(L, -1) == LUA_TSTRING );
@@ -101,6 +101,154 @@ TEST_CASE ( "dispatch" )
         }
     }
 
+    SECTION( "string span" )
+    {
+        CHECK( std::string(stack::type_name<StringSpan>(lua)) == "string" );
+
+        std::string s(1000, 'x');
+        stack::push(lua, StringSpan(s));
+        REQUIRE( lua_type(lua, -1) == LUA_TSTRING );
+        CHECK( stack::is<StringSpan>(lua, -1) );
+
+        // borrows the Lua string rather than copying it
+        auto v = stack::getx<StringSpan>(lua, -1);
+        CHECK( v.data() == lua_tostring(lua, -1) );
+        CHECK( v.str() == s );
+
+        CHECK( stack::cast<StringSpan>(lua, -1).data() == v.data() );
+
+        lua_pushinteger(lua, 1);
+        CHECK_THROWS_AS( stack::getx<StringSpan>(lua, -1), TypeError );
+    }
+
+    SECTION( "containers" )
+    {
+        CHECK( std::string(stack::type_name<std::vector<int>>(lua)) ==
+            "table of integer" );
+
+        SECTION( "vector" )
+        {
+            std::vector<double> v { 1.5, 2.5, 3.5 };
+            stack::push(lua, v);
+            REQUIRE( lua_type(lua, -1) == LUA_TTABLE );
+            CHECK( lua_objlen(lua, -1) == 3 );
+            CHECK( stack::is<std::vector<double>>(lua, -1) );
+
+            CHECK( stack::getx<std::vector<double>>(lua, -1) == v );
+            CHECK( stack::cast<std::vector<double>>(lua, -1) == v );
+
+            lua_pushinteger(lua, 1);
+            CHECK_THROWS_AS( stack::getx<std::vector<double>>(lua, -1), TypeError );
+        }
+
+        SECTION( "bad element" )
+        {
+            stack::push(lua, std::vector<std::string> { "a", "b" });
+            CHECK_THROWS_AS( stack::getx<std::vector<int>>(lua, -1), TypeError );
+
+            // the element slots are popped again
+            CHECK( lua_gettop(lua) == 1 );
+        }
+
+        SECTION( "array" )
+        {
+            std::array<int, 3> a {{ 1, 2, 3 }};
+            stack::push(lua, a);
+            CHECK( lua_objlen(lua, -1) == 3 );
+
+            auto b = stack::getx<std::array<int, 3>>(lua, -1);
+            CHECK( b == a );
+
+            // the length has to match
+            CHECK_THROWS_AS( (stack::getx<std::array<int, 2>>(lua, -1)), TypeError );
+        }
+
+        SECTION( "span" )
+        {
+            int raw[] = { 4, 5 };
+            stack::push(lua, Span<int>(raw, 2));
+
+            CHECK( stack::getx<std::vector<int>>(lua, -1) == std::vector<int>({ 4, 5 }) );
+        }
+
+        SECTION( "nested" )
+        {
+            std::vector<std::vector<std::string>> v { { "a" }, { "b", "c" } };
+            stack::push(lua, v);
+
+            auto w = stack::getx<std::vector<std::vector<std::string>>>(lua, -1);
+            CHECK( w == v );
+        }
+
+        SECTION( "map" )
+        {
+            CHECK( std::string(stack::type_name<std::map<std::string, int>>(lua)) ==
+                "table of string to integer" );
+
+            std::map<std::string, int> m { { "a", 1 }, { "b", 2 } };
+            stack::push(lua, m);
+            REQUIRE( lua_type(lua, -1) == LUA_TTABLE );
+
+            lua_getfield(lua, -1, "b");
+            CHECK( lua_tointeger(lua, -1) == 2 );
+            lua_pop(lua, 1);
+
+            CHECK( (stack::getx<std::map<std::string, int>>(lua, -1)) == m );
+            CHECK( (stack::cast<std::map<std::string, int>>(lua, -1)) == m );
+        }
+
+        SECTION( "names per state" )
+        {
+            // the element type is registered under another name in each
+            State other;
+
+            lua_newtable(lua);
+            util::TypeRegistry::open(lua).add<TUser>(lua, "TA", lua_gettop(lua));
+
+            lua_newtable(other);
+            util::TypeRegistry::open(other).add<TUser>(other, "TB", lua_gettop(other));
+
+            using Users = std::map<std::string, std::vector<TUser>>;
+
+            CHECK( std::string(stack::type_name<Users>(lua)) ==
+                "table of string to table of TA" );
+
+            CHECK( std::string(stack::type_name<Users>(other)) ==
+                "table of string to table of TB" );
+
+            CHECK( std::string(stack::type_name<std::vector<TUser>>(other)) ==
+                "table of TB" );
+
+            // built once, and again when the element is renamed
+            auto name = stack::type_name<Users>(lua);
+            CHECK( stack::type_name<Users>(lua) == name );
+
+            lua_newtable(lua);
+            util::TypeRegistry::open(lua).add<TUser>(lua, "TC", lua_gettop(lua));
+
+            CHECK( std::string(stack::type_name<Users>(lua)) ==
+                "table of string to table of TC" );
+        }
+
+        SECTION( "unordered map" )
+        {
+            using Map = std::unordered_map<int, std::vector<double>>;
+
+            Map m { { 1, { 0.5 } }, { 7, { 1.5, 2.5 } } };
+            stack::push(lua, m);
+
+            CHECK( stack::getx<Map>(lua, -1) == m );
+
+            // keys and values are both checked, and the walk is unwound
+            lua_pushliteral(lua, "x");
+            lua_pushnumber(lua, 1);
+            lua_settable(lua, -3);
+
+            CHECK_THROWS_AS( stack::getx<Map>(lua, -1), TypeError );
+            CHECK( lua_gettop(lua) == 1 );
+        }
+    }
+
     SECTION( "enum type" )
     {
         SECTION( "old enum" )
@@ -120,17 +268,21 @@ TEST_CASE ( "dispatch" )
 
     SECTION( "user type" )
     {
+        CHECK( std::string(stack::type_name<TUser>(lua)) == "unregistered userdata" );
+
         // must register type first
-        traits::type_name_storage<TUser>::value = "TUser";
+        luaL_newmetatable(lua, "TUser");
+        util::TypeRegistry::open(lua).add<TUser>(lua, "TUser", -1);
+        lua_pop(lua, 1);
 
-        CHECK( stack::type_name<TUser>() == "TUser" );
+        CHECK( std::string(stack::type_name<TUser>(lua)) == "TUser" );
 
         std::unique_ptr<TUser> u(new TUser);
 
         auto h = static_cast<TUser**>(lua_newuserdata(lua, sizeof(TUser*)));
         *h = u.get();
 
-        luaL_newmetatable(lua, "TUser");
+        luaL_getmetatable(lua, "TUser");
         lua_setmetatable(lua, -2);
 
         CHECK( stack::is<TUser>(lua, -1) );
@@ -151,6 +303,12 @@ TEST_CASE ( "dispatch" )
 
             lua_pushinteger(lua, 3);
             CHECK_FALSE( stack::is<TUser>(lua, -1) );
+
+            // userdata with some other metatable
+            lua_newuserdata(lua, sizeof(TUser*));
+            lua_newtable(lua);
+            lua_setmetatable(lua, -2);
+            CHECK_FALSE( stack::is<TUser>(lua, -1) );
         }
     }
 
@@ -171,6 +329,51 @@ TEST_CASE ( "dispatch" )
     {
         CHECK_THROWS_AS( stack::check<int>(lua, n), TypeError );
         CHECK( stack::getx<int>(lua, v) == i);
+
+        SECTION( "builtins" )
+        {
+            CHECK( stack::getx<unsigned>(lua, v) == 42u );
+            CHECK( stack::getx<double>(lua, v) == 42.0 );
+            CHECK( stack::getx<TEnum>(lua, v) == 42 );
+            CHECK_THROWS_AS( stack::getx<bool>(lua, v), TypeError );
+
+            lua_pushinteger(lua, 0);
+            CHECK_THROWS_AS( stack::getx<unsigned>(lua, -1), TypeError );
+
+            lua_pushinteger(lua, 1000);
+            CHECK_THROWS_AS( stack::getx<TEnum>(lua, -1), TypeError );
+        }
+
+        SECTION( "strings are not coerced" )
+        {
+            CHECK_THROWS_AS( stack::getx<std::string>(lua, v), TypeError );
+            CHECK_THROWS_AS( stack::getx<const char*>(lua, v), TypeError );
+            CHECK( lua_type(lua, v) == LUA_TNUMBER );
+
+            lua_pushliteral(lua, "foo");
+            CHECK( stack::getx<std::string>(lua, -1) == "foo" );
+            CHECK( std::string(stack::getx<const char*>(lua, -1)) == "foo" );
+        }
+
+        SECTION( "user types" )
+        {
+            luaL_newmetatable(lua, "TUser");
+            util::TypeRegistry::open(lua).add<TUser>(lua, "TUser", -1);
+            lua_pop(lua, 1);
+
+            auto p = util::userdata<TUser>::emplace(lua);
+            util::userdata<TUser>::assign_metatable(lua, -1);
+
+            CHECK( &stack::getx<TUser&>(lua, -1) == p );
+            CHECK( stack::getx<TUser*>(lua, -1) == p );
+            CHECK( stack::getx<TUser>(lua, -1).x == d_v );
+
+            CHECK_THROWS_AS( stack::getx<TUser&>(lua, v), TypeError );
+            CHECK_THROWS_AS( stack::getx<TUser*>(lua, n), TypeError );
+
+            lua_newuserdata(lua, sizeof(TUser*));
+            CHECK_THROWS_AS( stack::getx<TUser&>(lua, -1), TypeError );
+        }
     }
 
     SECTION( "exception content" )
@@ -186,6 +389,9 @@ TEST_CASE ( "dispatch" )
                 "TypeError: (arg #2) expected 'integer', got 'nil'" ;
 
             CHECK( e.what() == exp );
+
+            e.push(lua);
+            CHECK( std::string(lua_tostring(lua, -1)) == exp );
         }
         catch ( int )
         {
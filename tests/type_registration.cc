@@ -7,26 +7,52 @@ namespace t_type_registration
 // fixtures
 // -----------------------------------------------------------------------------
 
+struct TPos
+{
+    int x = 0;
+};
+
+struct TBase
+{
+    static int foo() { return 1; }
+};
+
 struct TUser
 {
     static int foo() { return 1; }
     int bar() const { return 2; }
     int buzz() { return 3; }
 
+    TUser scaled(int k) const { return TUser(x * k); }
+
+    static int twice(int i) { return 2 * i; }
+
+    std::string get_name() const { return name; }
+    void set_name(std::string s) { name = "<" + s + ">"; }
+
     int x = 0;
+    std::vector<int> items;
+    std::string name;
+    TPos pos;
 
     TUser() { }
     TUser(int y) : x(y) { }
 };
 
+struct TRecord
+{
+    const int id = 7;
+    double weight = 0;
+};
+
 static_assert(std::is_default_constructible<TUser>::value, "");
 
 template<typename T>
 static void register_class(lua_State* L, const char* name)
 {
-    Lua::traits::type_name_storage<T>::value = name;
     luaL_newmetatable(L, name);
     auto meta = lua_gettop(L);
+    Lua::util::TypeRegistry::open(L).add<T>(L, name, meta);
     lua_newtable(L);
     auto methods = lua_gettop(L);
     lua_pushstring(L, "__index");
@@ -40,17 +66,19 @@ template<typename T>
 static void unregister_class(lua_State* L)
 {
     using namespace Lua;
-    const auto& name = traits::type_name_storage<T>::value;
-    if ( name.empty() )
+    auto entry = util::find_type<T>(L);
+    if ( !entry )
         return;
 
+    const auto& name = entry->name;
+
     lua_pushstring(L, name.c_str());
     lua_pushnil(L);
     lua_rawset(L, LUA_REGISTRYINDEX);
     lua_pushnil(L);
     lua_setglobal(L, name.c_str());
 
-    traits::type_name_storage<T>::value = "";
+    util::TypeRegistry::open(L).remove<T>(L);
 }
 
 }
@@ -167,6 +195,45 @@ TEST_CASE( "class editor" )
             CHECK( info.has_ctor );
             CHECK( info.has_dtor );
         }
+
+        SECTION( "metatable cached" )
+        {
+            registration::Editor<TUser>(lua, "TUser").finish();
+
+            if ( luaL_dostring(lua, "return TUser.new()") )
+                FAIL( lua_tostring(lua, -1) );
+
+            CHECK( stack::is<TUser>(lua, -1) );
+
+            util::userdata<TUser>::push_metatable(lua);
+            luaL_getmetatable(lua, "TUser");
+            CHECK( lua_rawequal(lua, -2, -1) );
+        }
+
+        SECTION( "type entry" )
+        {
+            registration::Editor<TUser>(lua, "TUser")
+                .add_method("foo", &TUser::foo)
+                .add_method("bar", &TUser::bar);
+
+            auto entry = util::find_type<TUser>(lua);
+            REQUIRE( entry );
+            CHECK( entry->name == "TUser" );
+            CHECK( entry->method_count == 2 );
+
+            open_class<TUser>(lua).add_method("buzz", &TUser::buzz);
+            CHECK( entry->method_count == 3 );
+        }
+
+        SECTION( "names pinned once" )
+        {
+            registration::Editor<TUser>(lua, "TUser").finish();
+            auto pinned = StringCache::open(lua).size();
+            CHECK( pinned > 0 );
+
+            open_class<TUser>(lua).add_method("foo", &TUser::foo);
+            CHECK( StringCache::open(lua).size() == pinned );
+        }
     }
 
     SECTION( "full test" )
@@ -186,4 +253,296 @@ TEST_CASE( "class editor" )
         luaL_dostring(lua, "u = TUser.new(2)");
         luaL_dostring(lua, "print(u)");
     }
+
+    SECTION( "compile-time methods" )
+    {
+        registration::Editor<TUser>(lua, "TUser")
+            .add_method<decltype(&TUser::foo), &TUser::foo>("foo")
+            .add_method<decltype(&TUser::bar), &TUser::bar>("bar")
+            .add_method<decltype(&TUser::buzz), &TUser::buzz>("buzz")
+            .add_ctor<int>();
+
+        CHECK( util::find_type<TUser>(lua)->method_count == 3 );
+
+        const char code[] =
+            "local u = TUser.new(2)\n"
+            "return TUser.foo(), u:bar(), u:buzz()";
+
+        if ( luaL_dostring(lua, code) )
+            FAIL( lua_tostring(lua, -1) );
+
+        CHECK( lua_tointeger(lua, -3) == 1 );
+        CHECK( lua_tointeger(lua, -2) == 2 );
+        CHECK( lua_tointeger(lua, -1) == 3 );
+    }
+
+    SECTION( "returning user objects" )
+    {
+        registration::Editor<TUser>(lua, "TUser")
+            .add_method("scaled", &TUser::scaled)
+            .add_ctor<int>();
+
+        if ( luaL_dostring(lua, "return TUser.new(2):scaled(3):scaled(2)") )
+            FAIL( lua_tostring(lua, -1) );
+
+        REQUIRE( stack::is<TUser>(lua, -1) );
+        CHECK( stack::cast<TUser&>(lua, -1).x == 12 );
+    }
+}
+
+TEST_CASE( "container members" )
+{
+    using namespace Lua;
+    using namespace t_type_registration;
+
+    State lua;
+
+    registration::Editor<TUser>(lua, "TUser")
+        .add_proxy("items", &TUser::items)
+        .add_ctor<int>();
+
+    CHECK( util::find_type<TUser>(lua)->method_count == 1 );
+
+    SECTION( "live view" )
+    {
+        const char code[] =
+            "u = TUser.new(1)\n"
+            "local items = u:items()\n"
+            "items[1] = 5; items[2] = 6\n"
+            "return #items, items[2]";
+
+        if ( luaL_dostring(lua, code) )
+            FAIL( lua_tostring(lua, -1) );
+
+        CHECK( lua_tointeger(lua, -2) == 2 );
+        CHECK( lua_tointeger(lua, -1) == 6 );
+
+        lua_getglobal(lua, "u");
+        CHECK( stack::getx<TUser&>(lua, -1).items == std::vector<int>({ 5, 6 }) );
+    }
+
+    SECTION( "keeps its object alive" )
+    {
+        const char code[] =
+            "items = TUser.new(1):items()\n"
+            "collectgarbage()\n"
+            "items[1] = 7\n"
+            "return items[1]";
+
+        if ( luaL_dostring(lua, code) )
+            FAIL( lua_tostring(lua, -1) );
+
+        CHECK( lua_tointeger(lua, -1) == 7 );
+    }
+}
+
+TEST_CASE( "properties" )
+{
+    using namespace Lua;
+    using namespace t_type_registration;
+
+    State lua;
+
+    registration::Editor<TUser>(lua, "TUser")
+        .add_method("bar", &TUser::bar)
+        .add_property("x", &TUser::x)
+        .add_property("name", &TUser::get_name, &TUser::set_name)
+        .add_property("size", &TUser::bar)
+        .add_ctor<int>();
+
+    auto call = [&](const char* code) -> std::string
+    {
+        if ( luaL_dostring(lua, code) )
+            return lua_tostring(lua, -1);
+
+        return lua_isnil(lua, -1) ? "nil" : lua_tostring(lua, -1);
+    };
+
+    SECTION( "data members" )
+    {
+        CHECK( call("u = TUser.new(3); return u.x") == "3" );
+        CHECK( call("u.x = u.x + 4; return u.x") == "7" );
+
+        lua_getglobal(lua, "u");
+        CHECK( stack::getx<TUser&>(lua, -1).x == 7 );
+    }
+
+    SECTION( "getters and setters" )
+    {
+        CHECK( call("u = TUser.new(1); u.name = 'a'; return u.name") == "<a>" );
+        CHECK( call("return u.size") == "2" );
+    }
+
+    SECTION( "methods come first" )
+    {
+        CHECK( call("return TUser.new(1):bar()") == "2" );
+        CHECK( call("return TUser.new(1).nothing") == "nil" );
+        CHECK( call("return TUser.new(1)[1]") == "nil" );
+    }
+
+    SECTION( "methods inherited through the methods table" )
+    {
+        registration::Editor<TBase>(lua, "TBase")
+            .add_method("foo", &TBase::foo);
+
+        CHECK( call("setmetatable(TUser, { __index = TBase })\n"
+            "return TUser.new(1).foo()") == "1" );
+    }
+
+    SECTION( "user objects by reference" )
+    {
+        registration::Editor<TPos>(lua, "TPos")
+            .add_property("x", &TPos::x);
+
+        open_class<TUser>(lua)
+            .add_property("pos", &TUser::pos);
+
+        CHECK( call("u = TUser.new(1); u.pos.x = 4; return u.pos.x") == "4" );
+
+        lua_getglobal(lua, "u");
+        CHECK( stack::getx<TUser&>(lua, -1).pos.x == 4 );
+
+        // the reference keeps its object alive
+        CHECK( call("local p = TUser.new(1).pos\n"
+            "collectgarbage(); collectgarbage()\n"
+            "p.x = 6; return p.x") == "6" );
+    }
+
+    SECTION( "errors" )
+    {
+        CHECK( call("TUser.new(1).size = 3") ==
+            "[string \"TUser.new(1).size = 3\"]:1: "
+            "property 'size' of TUser is read-only" );
+
+        CHECK( call("TUser.new(1).y = 3") ==
+            "[string \"TUser.new(1).y = 3\"]:1: TUser has no property 'y'" );
+
+        CHECK( call("TUser.new(1).x = 'a'") ==
+            "TypeError: (arg #3) expected 'integer', got 'string'" );
+
+        // __index called directly, on something else
+        CHECK( call("return getmetatable(TUser.new(1)).__index({}, 'x')") ==
+            "TypeError: (arg #1) expected 'TUser', got 'table'" );
+
+        CHECK( call("getmetatable(TUser.new(1)).__newindex(io.stdout, 'x', 1)") ==
+            "TypeError: (arg #1) expected 'TUser', got 'userdata'" );
+    }
+
+    SECTION( "reopened" )
+    {
+        open_class<TUser>(lua)
+            .add_method("buzz", &TUser::buzz)
+            .add_property("x2", &TUser::x);
+
+        CHECK( call("u = TUser.new(5); u.x2 = 6; return u.x") == "6" );
+        CHECK( call("return u:buzz() + u:bar()") == "5" );
+        CHECK( call("return u.name") == "" );
+    }
+
+    SECTION( "const members" )
+    {
+        registration::Editor<TRecord>(lua, "TRecord")
+            .add_property("id", &TRecord::id)
+            .add_property("weight", &TRecord::weight);
+
+        CHECK( call("r = TRecord.new(); r.weight = 1.5; return r.id + r.weight") ==
+            "8.5" );
+
+        CHECK( call("r.id = 1") ==
+            "[string \"r.id = 1\"]:1: property 'id' of TRecord is read-only" );
+    }
+}
+
+TEST_CASE( "binding policies" )
+{
+    using namespace Lua;
+    using namespace t_type_registration;
+
+    State lua;
+
+    // unchecked bindings read a string argument as 0
+    auto call = [&](const char* code) -> std::string
+    {
+        if ( luaL_dostring(lua, code) )
+            return lua_tostring(lua, -1);
+
+        return std::to_string(lua_tointeger(lua, -1));
+    };
+
+    SECTION( "per method" )
+    {
+        registration::Editor<TUser>(lua, "TUser")
+            .add_method("checked", &TUser::twice)
+            .add_method<policy::unchecked>("unchecked", &TUser::twice)
+            .add_method<decltype(&TUser::twice), &TUser::twice,
+                policy::unchecked>("fixed");
+
+        CHECK( call("return TUser.checked(2)") == "4" );
+        CHECK( call("return TUser.unchecked(2)") == "4" );
+        CHECK( call("return TUser.fixed(2)") == "4" );
+
+        CHECK( call("return TUser.checked('x')") ==
+            "TypeError: (arg #1) expected 'integer', got 'string'" );
+
+        CHECK( call("return TUser.unchecked('x')") == "0" );
+        CHECK( call("return TUser.fixed('x')") == "0" );
+    }
+
+    SECTION( "per class" )
+    {
+        registration::Editor<TUser, policy::unchecked>(lua, "TUser")
+            .add_method("unchecked", &TUser::twice)
+            .add_method<policy::checked>("checked", &TUser::twice)
+            .add_method("bar", &TUser::bar)
+            .add_ctor<int>();
+
+        CHECK( call("return TUser.unchecked('x')") == "0" );
+        CHECK( call("return TUser.checked('x')") ==
+            "TypeError: (arg #1) expected 'integer', got 'string'" );
+
+        CHECK( call("return TUser.new(3):bar()") == "2" );
+    }
+
+    SECTION( "trusted" )
+    {
+#ifdef NDEBUG
+        CHECK( (std::is_same<policy::trusted, policy::unchecked>::value) );
+#else
+        CHECK( (std::is_same<policy::trusted, policy::checked>::value) );
+#endif
+    }
+}
+
+TEST_CASE( "per-state registry" )
+{
+    using namespace Lua;
+    using namespace t_type_registration;
+
+    State a;
+    State b;
+
+    register_class<TUser>(a, "TUser");
+    register_class<TUser>(b, "TUser");
+
+    auto ea = util::find_type<TUser>(a);
+    auto eb = util::find_type<TUser>(b);
+
+    REQUIRE( ea );
+    REQUIRE( eb );
+    CHECK( ea != eb );
+    CHECK( ea->meta != eb->meta );
+
+    util::userdata<TUser>::emplace(a);
+    util::userdata<TUser>::assign_metatable(a, -1);
+    CHECK( stack::is<TUser>(a, -1) );
+
+    util::userdata<TUser>::emplace(b);
+    util::userdata<TUser>::assign_metatable(b, -1);
+    CHECK( stack::is<TUser>(b, -1) );
+
+    // removing the type from one state leaves the other intact
+    util::TypeRegistry::open(a).remove<TUser>(a);
+    CHECK_FALSE( util::find_type<TUser>(a) );
+    CHECK_FALSE( stack::is<TUser>(a, -1) );
+    CHECK( stack::is<TUser>(b, -1) );
 }
@@ -0,0 +1,202 @@
+#include <cmath>
+#include <cstdint>
+
+#include "value_registration.h"
+#include "common.h"
+
+namespace t_value_registration
+{
+// -----------------------------------------------------------------------------
+// fixtures
+// -----------------------------------------------------------------------------
+
+struct Vec2
+{
+    float x;
+    float y;
+
+    float length() const noexcept
+    { return std::sqrt(x * x + y * y); }
+
+    Vec2 scaled(float k) const noexcept
+    { return { x * k, y * k }; }
+
+    void add(Vec2 o) noexcept
+    {
+        x += o.x;
+        y += o.y;
+    }
+
+    static Vec2 unit() noexcept
+    { return { 1, 0 }; }
+};
+
+// laid out differently from what the FFI makes of its fields
+#pragma pack(push, 1)
+struct Packed
+{
+    std::int8_t tag;
+    std::int32_t count;
+};
+#pragma pack(pop)
+
+// only some of the fields are visible to Lua
+struct Sample
+{
+    char tag;
+    double value;
+    std::int32_t count;
+    std::uint8_t bytes[3];
+};
+
+static void run(lua_State* L, const char* code)
+{
+    if ( luaL_dostring(L, code) )
+        FAIL( lua_tostring(L, -1) );
+}
+
+} // namespace t_value_registration
+
+// -----------------------------------------------------------------------------
+// test cases
+// -----------------------------------------------------------------------------
+
+TEST_CASE( "value types" )
+{
+    using namespace Lua;
+    using namespace t_value_registration;
+
+    State lua;
+
+    SECTION( "declaration" )
+    {
+        auto e = register_value<Vec2>(lua, "Vec2");
+        e.add_field("y", &Vec2::y).add_field("x", &Vec2::x);
+
+        CHECK( e.declaration() == "typedef struct { float x; float y; } Vec2;" );
+    }
+
+    SECTION( "padding" )
+    {
+        auto e = register_value<Sample>(lua, "Sample");
+        e.add_field("count", &Sample::count)
+            .add_field("bytes", &Sample::bytes);
+
+        CHECK( e.declaration() ==
+            "typedef struct __attribute__((aligned(8))) { "
+            "uint8_t pad_0[16]; int32_t count; uint8_t bytes[3]; "
+            "uint8_t pad_23[1]; } Sample;" );
+
+        REQUIRE( e.finish() );
+
+        run(lua,
+            "local s = Sample()\n"
+            "s.count = 3; s.bytes[2] = 7\n"
+            "local ffi = require('ffi')\n"
+            "return ffi.sizeof(s), ffi.offsetof('Sample', 'count'), s.bytes[2]");
+
+        CHECK( lua_tointeger(lua, -3) == sizeof(Sample) );
+        CHECK( lua_tointeger(lua, -2) == offsetof(Sample, count) );
+        CHECK( lua_tointeger(lua, -1) == 7 );
+    }
+
+    SECTION( "fields and methods" )
+    {
+        REQUIRE( (register_value<Vec2>(lua, "Vec2")
+            .add_field("x", &Vec2::x)
+            .add_field("y", &Vec2::y)
+            .add_method<decltype(&Vec2::length), &Vec2::length>("length")
+            .add_method<decltype(&Vec2::scaled), &Vec2::scaled>("scaled")
+            .add_method<decltype(&Vec2::add), &Vec2::add>("add")
+            .add_method<decltype(&Vec2::unit), &Vec2::unit>("unit")
+            .finish()) );
+
+        run(lua,
+            "local v = Vec2(3, 4)\n"
+            "local len = v:length()\n"
+            "local w = v:scaled(2)\n"
+            "v:add(v.unit())\n"
+            "w.y = w.y + 1\n"
+            "return type(v), len, w.x, w.y, v.x");
+
+        CHECK( std::string(lua_tostring(lua, -5)) == "cdata" );
+        CHECK( lua_tonumber(lua, -4) == 5 );
+        CHECK( lua_tonumber(lua, -3) == 6 );
+        CHECK( lua_tonumber(lua, -2) == 9 );
+        CHECK( lua_tonumber(lua, -1) == 4 );
+    }
+
+    SECTION( "nil self" )
+    {
+        REQUIRE( (register_value<Vec2>(lua, "Vec2")
+            .add_field("x", &Vec2::x)
+            .add_method<decltype(&Vec2::length), &Vec2::length>("length")
+            .add_method<decltype(&Vec2::add), &Vec2::add>("add")
+            .finish()) );
+
+        REQUIRE( luaL_dostring(lua, "return Vec2.length(nil)") );
+        CHECK( std::string(lua_tostring(lua, -1)) ==
+            "TypeError: (arg #1) expected 'Vec2', got 'nil'" );
+
+        REQUIRE( luaL_dostring(lua,
+            "return Vec2.add(require('ffi').cast('Vec2 *', nil), Vec2(1))") );
+        CHECK( std::string(lua_tostring(lua, -1)) ==
+            "TypeError: (arg #1) expected 'Vec2', got 'nil'" );
+    }
+
+    SECTION( "mismatched layout" )
+    {
+        // the FFI would align count to 4
+        CHECK_FALSE( register_value<Packed>(lua, "Packed")
+            .add_field("tag", &Packed::tag)
+            .add_field("count", &Packed::count)
+            .finish() );
+
+        // nothing was defined, so a corrected retry works
+        REQUIRE( luaL_dostring(lua,
+            "return pcall(require('ffi').typeof, 'Packed')") == 0 );
+        CHECK_FALSE( lua_toboolean(lua, -2) );
+
+        CHECK( register_value<Packed>(lua, "Packed")
+            .add_field("tag", &Packed::tag)
+            .finish() );
+
+        run(lua, "return require('ffi').sizeof('Packed')");
+        CHECK( lua_tointeger(lua, -1) == sizeof(Packed) );
+    }
+
+    SECTION( "method cast failing" )
+    {
+        run(lua,
+            "local ffi = require('ffi')\n"
+            "ffi.cast = function() error('no casts') end");
+
+        CHECK_FALSE( (register_value<Vec2>(lua, "Vec2")
+            .add_field("x", &Vec2::x)
+            .add_field("y", &Vec2::y)
+            .add_method<decltype(&Vec2::length), &Vec2::length>("length")
+            .finish()) );
+
+        // the typedef was already defined, but nothing else was set
+        REQUIRE( luaL_dostring(lua,
+            "return pcall(require('ffi').typeof, 'Vec2')") == 0 );
+        CHECK( lua_toboolean(lua, -2) );
+
+        lua_getglobal(lua, "Vec2");
+        CHECK( lua_isnil(lua, -1) );
+    }
+
+    SECTION( "without the ffi" )
+    {
+        auto L = luaL_newstate();
+
+        CHECK_FALSE( register_value<Vec2>(L, "Vec2")
+            .add_field("x", &Vec2::x)
+            .finish() );
+
+        lua_getglobal(L, "Vec2");
+        CHECK( lua_isnil(L, -1) );
+
+        lua_close(L);
+    }
+}